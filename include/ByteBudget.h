@@ -0,0 +1,41 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+
+#include "common.h"
+
+/*	Limits the number of bytes in flight (eg. copy buffers of all workers together). acquire waits until
+	the bytes fit in the limit. Request bigger than the whole limit waits until nothing else is in flight,
+	so it can't wait forever.
+*/
+class ByteBudget
+{
+private:
+	QWORD m_limit;
+	QWORD m_inUse = 0;
+	std::mutex m_mutex;
+	std::condition_variable m_released;
+
+public:
+	explicit ByteBudget(QWORD limit);
+	ByteBudget(const ByteBudget&) = delete;
+	ByteBudget& operator=(const ByteBudget&) = delete;
+
+	void setLimit(QWORD limit);
+	void acquire(QWORD size);
+	void release(QWORD size);
+};
+
+//bytes taken from the budget for the lifetime of the object
+class ByteBudgetGuard
+{
+private:
+	ByteBudget& m_budget;
+	QWORD m_size;
+
+public:
+	ByteBudgetGuard(ByteBudget& budget, QWORD size);
+	~ByteBudgetGuard();
+	ByteBudgetGuard(const ByteBudgetGuard&) = delete;
+	ByteBudgetGuard& operator=(const ByteBudgetGuard&) = delete;
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <cstdio>
+
+#include "common.h"
+
+class OutputFile;
+
+/*	Source of the analyzed compound file. Every read is positional (offset is always given), so the source
+	doesn't keep a file pointer. Sources which keep the whole content in memory return it by data(),
+	then streams can be returned as views without copying. Sources which support file copy can move bytes
+	straight to the output file (eg. by copy_file_range), without a buffer in user space.
+*/
+class ByteSource
+{
+public:
+	virtual ~ByteSource();
+
+	virtual QWORD size() const = 0;
+	virtual bool read(QWORD offset, void* buffer, QWORD size) const = 0;
+	virtual const BYTE* data() const;
+	virtual bool supportsFileCopy() const;
+	virtual bool copyToFile(QWORD offset, QWORD size, OutputFile& output) const;
+};
+
+//bytes which are already in memory (eg. unpacked by archive extractor)
+class MemoryByteSource : public ByteSource
+{
+private:
+	const BYTE* m_data = nullptr;
+	QWORD m_size = 0;
+	std::vector<BYTE> m_ownedData;
+
+public:
+	void setView(const BYTE* data, QWORD size);
+	void assign(std::vector<BYTE>&& data);
+
+	QWORD size() const override;
+	bool read(QWORD offset, void* buffer, QWORD size) const override;
+	const BYTE* data() const override;
+};
+
+/*	Regular file read by pread (ReadFile with offset on windows). It is used when the file can't be mapped
+	(eg. 32-bit build and huge file) or as a temporary file for spooled data.
+*/
+class FileByteSource : public ByteSource
+{
+private:
+	QWORD m_size = 0;
+
+#ifdef _WIN32
+	void* m_fileHandle = nullptr;
+#else
+	int m_fileDescriptor = -1;
+#endif
+
+public:
+	FileByteSource();
+	~FileByteSource();
+	FileByteSource(const FileByteSource&) = delete;
+	FileByteSource& operator=(const FileByteSource&) = delete;
+
+	bool open(const std::string& path);
+	bool createTemporary();
+	bool append(const BYTE* data, QWORD size);
+	void close();
+
+	QWORD size() const override;
+	bool read(QWORD offset, void* buffer, QWORD size) const override;
+	bool supportsFileCopy() const override;
+	bool copyToFile(QWORD offset, QWORD size, OutputFile& output) const override;
+};
+
+/*	Non-seekable input (pipe, stdin). Data is read once until the end. Up to "memoryLimit" bytes are kept
+	in memory, bigger inputs are moved to the temporary file which is deleted on close.
+*/
+class SpooledByteSource : public ByteSource
+{
+public:
+	static constexpr QWORD Default_Memory_Limit = 64 * 1024 * 1024;
+
+private:
+	MemoryByteSource m_memory;
+	FileByteSource m_file;
+	bool m_spilled = false;
+
+public:
+	bool open(FILE* input, QWORD memoryLimit = Default_Memory_Limit);
+
+	QWORD size() const override;
+	bool read(QWORD offset, void* buffer, QWORD size) const override;
+	const BYTE* data() const override;
+	bool supportsFileCopy() const override;
+	bool copyToFile(QWORD offset, QWORD size, OutputFile& output) const override;
+};
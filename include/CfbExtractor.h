@@ -1,8 +1,15 @@
 #pragma once
-#include <map>
-#include <fstream>
+#include <memory>
+#include <vector>
+#include <mutex>
 
 #include "common.h"
+#include "MappedFile.h"
+#include "StreamReader.h"
+#include "DirectoryIndex.h"
+#include "SectorLocator.h"
+#include "SectorCache.h"
+#include "OutputFile.h"
 
 // a whole implementation is based on: 
 // [MS-CFB]: Compound File Binary File Format
@@ -16,9 +23,12 @@
 
 #define CLSID_LENGTH 0X10
 
+#define MAXREGSECT	0xFFFFFFFA
+#define DIFSECT		0xFFFFFFFC
 #define FATSECT		0xFFFFFFFD
 #define ENDOFCHAIN	0xFFFFFFFE
 #define FREESECT	0xFFFFFFFF
+#define NOSTREAM	0xFFFFFFFF
 
 //enums
 enum DirEntryType
@@ -77,41 +87,92 @@ struct DirectoryEntry
 static_assert(sizeof(DirectoryEntry) == 0x80, "DirectoryEntry incorrect size");
 #pragma pack(pop)
 
+/*	Content of stream returned by CfbExtractor. If stream is stored in consecutive sectors, then it is
+	only a view into the mapped file (or miniStream) and nothing is copied. Otherwise sectors are
+	copied into owned buffer.
+*/
+class StreamBuffer
+{
+private:
+	const BYTE* m_data = nullptr;
+	QWORD m_size = 0;
+	std::unique_ptr<BYTE[]> m_ownedData;
+
+public:
+	void setView(const BYTE* data, QWORD size);
+	BYTE* allocate(QWORD size);
+	void reset();
+
+	//getters
+	const BYTE* data() const;
+	QWORD size() const;
+	bool isView() const;
+};
+
+struct FileExtent;
+
 class CfbExtractor
 {
+public:
+	//used only if the source doesn't keep the file in memory (eg. pread or spooled file)
+	static constexpr QWORD Default_Sector_Cache_Size = 16 * 1024 * 1024;
+
 private:
-	std::ifstream m_input;
+	std::unique_ptr<ByteSource> m_input;
+	SectorCache m_sectorCache;			//every read of m_input goes through the cache
 	CfbHeader m_cfbHeader = { 0 };
-	DWORD m_fileSize = 0;
+	QWORD m_fileSize = 0;
 	DWORD m_sectionCount = 0;
 	DWORD m_sectionSize = 0;
 	DWORD m_miniSectionSize = 0;
-	DWORD m_fatArraySize = 0;
-	DWORD m_miniFatArraySize = 0;
+	DWORD m_fatArraySize = 0;		//entries loaded from fat sections, may be less than m_sectionCount
 	DWORD m_dirEntriesCount = 0;
 
 	DWORD* m_fatEntries = nullptr;
-	DWORD* m_miniFatEntries = nullptr;
 	DirectoryEntry* m_dirEntries = nullptr;
-	BYTE* m_miniStream = nullptr;
 	DirectoryEntry m_rootDirEntry = { 0 };
-	std::map<std::string, DWORD> m_mapStreamNameToSectionId;
+	SectorLocator m_sectorLocator;
+	DirectoryIndex m_directoryIndex;
+
+	//mini stream is loaded lazily by the first reader of small stream. Later it is only read
+	mutable std::once_flag m_miniStreamOnce;
+	mutable bool m_miniStreamStatus = false;
+	mutable DWORD m_miniFatArraySize = 0;
+	mutable DWORD* m_miniFatEntries = nullptr;
+	mutable SectorLocator m_miniSectorLocator;
+	mutable std::vector<DWORD> m_miniStreamSectors;		//regular sectors which store the mini stream
 
 public:
 	CfbExtractor();
 	~CfbExtractor();
 	bool initialize(const std::string msiName);
+	bool initialize(std::unique_ptr<ByteSource> input);
 	bool parseCfbHeader();
 	bool loadFatEntries();
-	bool loadMiniFatEntries();
 	bool loadDirEntries();
-	bool loadMiniStreamEntries();
 	bool initRedableStreamNamesFromRawNames();
-	bool readAndAllocateStream(std::string tableName, BYTE** stream, DWORD& streamSize);
+	bool validateChains();
+	bool readStream(const std::string& streamPath, StreamBuffer& stream) const;
+	bool openStream(const std::string& streamPath, StreamReader& reader) const;
+	bool canCopyStreamToFile() const;
+	bool copyStreamToFile(const std::string& streamPath, OutputFile& output) const;
+	void setSectorCacheSize(QWORD cacheSize);
 
 	//getter
-	const std::map<std::string, DWORD>& getMapStreamNameToSectionId() const;
+	const DirectoryIndex& getDirectoryIndex() const;
+	SectorCacheStats getSectorCacheStats() const;
+	QWORD getFileSize() const;
 
 private:
+	bool loadMiniStream() const;
+	bool loadMiniFatEntries() const;
+	bool loadMiniStreamEntries() const;
+	bool validateMiniChains() const;
+	DWORD getFatEntriesCount() const;
 	bool convertStreamNameToReadableString(const WORD* tableNameArray, const DWORD tableNameLength, std::string& readableStreamName);
+	bool validateChain(const char* chainName, const DWORD* sectionInfoArray, DWORD sectionArraySize, DWORD firstSector, SectorBitmap& claimedSectors) const;
+	bool getStreamEntry(const std::string& streamPath, const DirectoryEntry*& streamEntry, DWORD& entryId) const;
+	QWORD getStreamSize(const DirectoryEntry& streamEntry) const;
+	bool readSectorChain(DWORD sectorIndex, QWORD streamSize, bool fromMiniStream, StreamBuffer& stream) const;
+	bool getFileExtents(DWORD sectorIndex, QWORD streamSize, bool fromMiniStream, std::vector<FileExtent>& extents) const;
 };
\ No newline at end of file
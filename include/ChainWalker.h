@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <memory>
+
+#include "common.h"
+
+//problems which can be found in the sector chain
+enum class ChainError
+{
+	None,
+	OutOfRange,		//sector index is out of FAT (or miniFAT) array
+	Cycle,			//sector was already visited in this chain
+	CrossLinked,	//sector belongs also to other chain
+};
+
+/*	Bitmap with one bit per sector. Memory is allocated lazily in pages, so creating the bitmap
+	for a huge file and visiting only a few sectors is cheap.
+*/
+class SectorBitmap
+{
+private:
+	static constexpr DWORD Bits_In_Page = 0x8000;
+	static constexpr DWORD Words_In_Page = Bits_In_Page / 64;
+
+	std::vector<std::unique_ptr<QWORD[]>> m_pages;
+
+public:
+	void init(DWORD sectorCount);
+	bool testAndSet(DWORD sector);
+};
+
+/*	Walks the FAT (or miniFAT) chain sector by sector. Each sector is visited at most once, so the walk
+	ends in O(chain length) even for a crafted file with loops in the chain.
+	If "claimedSectors" is given, then sectors of all previously walked chains are remembered there and
+	cross-linked chains are detected too.
+*/
+class ChainWalker
+{
+private:
+	const DWORD* m_sectionInfoArray = nullptr;
+	DWORD m_sectionArraySize = 0;
+	DWORD m_currentSector = 0;
+	SectorBitmap m_visited;
+	SectorBitmap* m_claimedSectors = nullptr;
+
+	ChainError m_error = ChainError::None;
+	DWORD m_errorSector = 0;
+
+public:
+	ChainWalker();
+	ChainWalker(const DWORD* sectionInfoArray, DWORD sectionArraySize, DWORD firstSector, SectorBitmap* claimedSectors = nullptr);
+	void init(const DWORD* sectionInfoArray, DWORD sectionArraySize, DWORD firstSector, SectorBitmap* claimedSectors = nullptr);
+
+	bool next(DWORD& sector);
+	void logError(const char* chainName) const;
+
+	//getters
+	DWORD currentSector() const;
+	ChainError error() const;
+	DWORD errorSector() const;
+};
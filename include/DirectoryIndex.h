@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+struct DirectoryEntry;
+
+//stream or storage found in the directory tree
+struct DirectoryNode
+{
+	std::string name;			//readable name of the entry
+	std::string path;			//names of parent storages and the entry, separated by Path_Separator
+	DWORD entryId;				//index in the directory entries array
+	DWORD parentEntryId;		//storage which contains the entry (0 is the root storage)
+	BYTE objectType;
+};
+
+/*	Index of the directory tree. In compound file each storage keeps its children as a red-black tree
+	(leftSiblingId/rightSiblingId), and childId points to the root of this tree. Index walks these trees
+	from the root storage, so streams with the same name in different storages don't overwrite each other.
+	Nodes can be found by full path in O(1) thanks to the open addressing hash table.
+	Streams of the root storage have path equal to their name, eg. "!_StringPool", nested ones "Storage/Stream".
+*/
+class DirectoryIndex
+{
+public:
+	static constexpr char Path_Separator = '/';
+
+private:
+	static constexpr DWORD Empty_Slot = 0xFFFFFFFF;
+
+	std::vector<DirectoryNode> m_nodes;		//sorted by path
+	std::vector<DWORD> m_slots;				//index of the node or Empty_Slot
+	QWORD m_slotMask = 0;
+
+public:
+	bool build(const DirectoryEntry* dirEntries, DWORD dirEntriesCount, const std::vector<std::string>& entryNames);
+	void clear();
+	const DirectoryNode* find(const std::string& path) const;
+
+	//getter
+	const std::vector<DirectoryNode>& getNodes() const;
+
+private:
+	void buildHashTable();
+};
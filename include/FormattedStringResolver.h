@@ -0,0 +1,54 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+
+#include "common.h"
+
+/*	Resolves msi formatted strings (eg. "[INSTALLDIR]tool.exe"). Input is scanned once from left to right:
+	- "[Name]" is replaced with the value of property "Name". Value is resolved too, so properties can be nested,
+	- "[[Name]]" is an indirection: value of "Name" is a name of property which is used,
+	- "[\x]" is an escaped char x (eg. "[\[]" means '['),
+	- unknown properties and other forms (eg. "[#File]", "[%ENV]") are left as they are.
+	Fully resolved values are memoized, and a property which refers to itself (directly or not) is left unresolved.
+*/
+class FormattedStringResolver
+{
+private:
+	//nested references deeper than this are left unresolved
+	static constexpr DWORD Max_Depth = 64;
+
+	enum class ResolveState
+	{
+		InProgress,
+		Done
+	};
+
+	struct ResolvedProperty
+	{
+		ResolveState state;
+		std::string value;
+		bool complete;		//false if the depth limit cut the resolution short
+		DWORD depth;		//depth at which value was resolved
+	};
+
+	const std::map<std::string_view, std::string_view>& m_properties;
+
+	//key: propertyName, value: resolved value. Keys point to m_properties keys
+	std::unordered_map<std::string_view, ResolvedProperty> m_resolved;
+
+public:
+	explicit FormattedStringResolver(const std::map<std::string_view, std::string_view>& properties);
+
+	void resolve(std::string_view input, std::string& output);
+	void invalidate();
+
+private:
+	bool resolveInto(std::string_view input, std::string& output, DWORD depth);
+	bool resolveReference(std::string_view reference, std::string& output, DWORD depth);
+	bool resolveProperty(std::string_view name, DWORD depth, std::string& output, bool& complete);
+	static void pairBrackets(std::string_view input, std::vector<size_t>& closingBrackets);
+	static bool isPropertyName(std::string_view name);
+};
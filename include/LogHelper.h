@@ -1,9 +1,11 @@
 #pragma once
+#include <mutex>
 
 enum class LogOutput
 {
 	Undefined,
 	Std,
+	StdErr,		//stdout is used for results
 	File,
 };
 
@@ -19,6 +21,7 @@ class LogHelper
 private:
 	static std::ofstream logFile;
 	static LogOutput outputType;
+	static std::mutex logMutex;
 
 private:
 	static void internalLog(const char* logLevel, const char* msg);
@@ -26,6 +29,7 @@ private:
 public:
 	static bool init(const char* path);
 	static void init();
+	static void initStdErr();
 	static void deinit();
 
 	static void PrintLog(LogLevel lvl, const char* msg);
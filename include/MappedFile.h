@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+
+#include "common.h"
+#include "ByteSource.h"
+
+/*	Read-only memory mapping of the whole input file. Thanks to that every sector of compound file
+	can be accessed directly by pointer, without seek and read syscalls and without copying.
+	Implementation uses CreateFileMapping on windows and mmap on other platforms.
+*/
+class MappedFile : public ByteSource
+{
+private:
+	const BYTE* m_data = nullptr;
+	QWORD m_size = 0;
+
+#ifdef _WIN32
+	void* m_fileHandle = nullptr;
+	void* m_mappingHandle = nullptr;
+#else
+	int m_fileDescriptor = -1;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const;
+
+	QWORD size() const override;
+	bool read(QWORD offset, void* buffer, QWORD size) const override;
+	const BYTE* data() const override;
+};
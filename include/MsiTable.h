@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+#include <string_view>
+
+#include "common.h"
+#include "CfbExtractor.h"
+
+enum class ColumnKind
+{
+	OrdString, //ordinal string
+	LocString, //localized string
+	Number,
+	Unknown
+};
+
+struct ColumnTypeInfo
+{
+	ColumnKind kind;
+	WORD value;
+};
+
+struct ColumnInfo
+{
+	WORD index;
+	std::string_view name;
+	ColumnTypeInfo type;
+};
+
+//column with its place in the row. In the stream column starts at rowOffset * rowCount
+struct ColumnDescriptor
+{
+	ColumnInfo info;
+	DWORD fieldSize;
+	DWORD rowOffset;
+};
+
+/*	One column of the table. Values of column are stored one after another in the table stream,
+	so column is only a pointer to the first value and size of the field (2 or 4 bytes, 3 for long string indices).
+*/
+class MsiTableColumn
+{
+private:
+	const BYTE* m_data = nullptr;
+	DWORD m_fieldSize = 0;
+	DWORD m_rowCount = 0;
+
+public:
+	MsiTableColumn() = default;
+	MsiTableColumn(const BYTE* data, DWORD fieldSize, DWORD rowCount);
+
+	DWORD get(DWORD row) const;
+	void unpack(DWORD firstRow, DWORD count, DWORD* output) const;
+
+	//getters
+	const BYTE* data() const;
+	DWORD fieldSize() const;
+	DWORD size() const;
+};
+
+class MsiTable;
+
+//one row of the table. Values are read from columns, nothing is copied
+class MsiTableRow
+{
+private:
+	const MsiTable* m_table = nullptr;
+	DWORD m_row = 0;
+
+public:
+	MsiTableRow(const MsiTable* table, DWORD row);
+
+	DWORD operator[](DWORD column) const;
+	DWORD size() const;
+};
+
+/*	Table is stored in the stream column by column: first column values for each row, next second, etc.
+	MsiTable keeps this layout. The stream (very often only a view into the mapped file) isn't copied
+	or transposed, columns are located by offsets and values are read when asked.
+*/
+class MsiTable
+{
+private:
+	StreamBuffer m_stream;
+	std::vector<ColumnInfo> m_columns;
+	std::vector<MsiTableColumn> m_columnData;
+	DWORD m_rowCount = 0;
+
+public:
+	bool init(StreamBuffer&& stream, const ColumnDescriptor* columns, DWORD columnCount, DWORD rowByteSize);
+	void clear();
+
+	DWORD get(DWORD row, DWORD column) const;
+	MsiTableRow row(DWORD row) const;
+	const MsiTableColumn& column(DWORD column) const;
+
+	//getters
+	const std::vector<ColumnInfo>& getColumns() const;
+	DWORD rowCount() const;
+	DWORD columnCount() const;
+	QWORD memoryUsage() const;
+
+	static void getColumnType(const WORD columnWordType, ColumnTypeInfo& columnTypeInfo);
+	static DWORD getFieldSize(const ColumnTypeInfo& columnTypeInfo, DWORD stringRefSize);
+};
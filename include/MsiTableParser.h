@@ -1,32 +1,28 @@
 #pragma once
 #include <map>
+#include <deque>
+#include <fstream>
+#include <string_view>
 
 #include "CfbExtractor.h"
+#include "StringPool.h"
+#include "MsiTable.h"
+#include "TableWriter.h"
+#include "TableCache.h"
+#include "ByteBudget.h"
+#include "OutputSink.h"
+#include "SchemaCatalog.h"
+#include "MsiTableViews.h"
+#include "FormattedStringResolver.h"
+#include "PowerShellAction.h"
 #include "customActionConstants.h"
 
-enum class ColumnKind
-{
-	OrdString, //ordinal string
-	LocString, //localized string
-	Number,
-	Unknown
-};
-
-struct ColumnTypeInfo
-{
-	ColumnKind kind;
-	WORD value;
-};
-
-struct ColumnInfo
-{
-	WORD index;
-	std::string name;
-	ColumnTypeInfo type;
-};
-
 class MsiTableParser
 {
+public:
+	//default limit of bytes in copy buffers of all workers together
+	static constexpr QWORD Default_In_Flight_Limit = 64 * 1024 * 1024;
+
 private:
 	//CONSTANTS
 	//metadata table names
@@ -36,42 +32,55 @@ private:
 	static constexpr char Columns_Stream_Name[] = "!_Columns";
 
 	//ordinary table names
-	static constexpr char CustomAction_Table_Name[] = "CustomAction";
-	static constexpr char Property_Table_Name[] = "Property";
 	static constexpr char AI_FileDownload_Table_Name[] = "AI_FileDownload";
 	static constexpr char MPB_RunActions_Table_Name[] = "MPB_RunActions";
 
+	//default size of buffer used to copy embedded files
+	static constexpr DWORD Default_Io_Buffer_Size = 1024 * 1024;
+
+	//output directories and files, relative to the output root
+	static constexpr char Scripts_Dir_Name[] = "scripts";
+	static constexpr char Tables_Dir_Name[] = "tables";
+	static constexpr char Files_Dir_Name[] = "files";
+	static constexpr char Actions_File_Name[] = "actions.txt";
+
+	//rows of table unpacked at once during printing
+	static constexpr DWORD Unpack_Block_Rows = 256;
+
 	//MEMBERS
 	//when I try make it const, then some methods from CfbExtractor must be const
 	//and then occurs problem with templates. Strange thing
 	CfbExtractor& m_cfbExtractor;
-	const std::string m_outputDir;
-	const std::string m_scriptsDir;
-	const std::string m_tablesDir;
-	const std::string m_filesDir;
+	OutputSink& m_output;		//all results are written through the sink (directory, tar, stdout)
 
-	std::vector<std::string> m_vecStrings;
+	StringPool m_stringPool;
+	TableCache m_tableCache;		//tables are decoded once and shared by analysis stages
 	std::vector<DWORD> m_tableNameIndices;
+	SchemaCatalog m_schemaCatalog;		//tables and columns from !_Tables and !_Columns
 	
-	DWORD m_stringCount = 0;
-	BYTE* m_columnsByteStream = nullptr;
-	DWORD m_allColumnsCount = 0;
+	DWORD m_ioBufferSize = Default_Io_Buffer_Size;
+	ByteBudget m_ioBudget;		//copy buffers of embedded files saved at once
+	TableFormat m_tableFormat = TableFormat::Text;
+	ThreadPool* m_threadPool = nullptr;		//not owned. nullptr means everything is done in the calling thread
 	
 
-	//key: tableNameIndex, value: std::pair<columnCount, columnOffset>		TableName -> TN
-	//(columnOffset is a index of the first column for table in !_Columns
-	std::map<DWORD, std::pair<DWORD, DWORD>> m_mapTNIndexToColumnCountAndOffset;
-
-	//key: tableNameString, value: tableNameId.		TableName -> TN
-	std::map<std::string, DWORD> m_mapTNStringToTNIndex;
+	//key: propertyName, value: propertyName. Views point to m_stringPool or m_derivedStrings
+	std::map<std::string_view, std::string_view> m_mapProperties;
+	FormattedStringResolver m_propertyResolver;		//resolves properties from m_mapProperties
 
-	//key: propertyName, value: propertyName
-	std::map<std::string, std::string> m_mapProperties;
+	//strings created during analysis (eg. property values set by custom actions). Deque doesn't move them
+	std::deque<std::string> m_derivedStrings;
 
 	//METHODS
 public:
-	MsiTableParser(CfbExtractor& extractor, const std::string outDir);
+	MsiTableParser(CfbExtractor& extractor, OutputSink& output);
 	~MsiTableParser();
+	void setIoBufferSize(DWORD ioBufferSize);
+	void setInFlightLimit(QWORD inFlightLimit);
+	void setTableFormat(TableFormat tableFormat);
+	void setThreadPool(ThreadPool* threadPool);
+	void setTableCacheSize(QWORD tableCacheSize);
+	TableCacheStats getTableCacheStats() const;
 	bool initStringVector();
 	bool readTableNamesFromMetadata();
 	bool extractColumnsFromMetadata();
@@ -81,12 +90,21 @@ public:
 	bool saveAllFiles(DWORD& savedFilesCount);
 
 private:
-	bool writeToFile(const std::string fileName, const char* pStream, size_t streamSize, std::ios_base::openmode mod = std::ios::out);
-	bool getTableNameIndex(const std::string tableName, DWORD& index);
-	void getColumnType(const WORD columnWordType, ColumnTypeInfo& columnTypeInfo);
-	bool transformPS1Script(const std::string rawScript, std::string& decodedScript);
-	bool loadTable(const std::string tableName, std::vector<ColumnInfo>& columns, std::vector<std::vector<DWORD>>& table);
-	bool useProperties(std::string inputString, std::string& outputString);
+	bool writeToFile(const std::string fileName, const char* pStream, size_t streamSize);
+	bool writeStreamToFile(const std::string fileName, const std::string streamName);
+	bool getTableDescriptor(const std::string tableName, const TableDescriptor*& table);
+	bool loadTable(const std::string tableName, MsiTable& table);
+	bool getTable(const std::string tableName, std::shared_ptr<const MsiTable>& table);
+
+	// well known table with columns checked against the schema (see MsiTableViews.h)
+	template <class Schema>
+	bool getTypedTable(TypedTableView<Schema>& view)
+	{
+		std::shared_ptr<const MsiTable> table;
+		ASSERT_BOOL(getTable(Schema::Table_Name, table));
+		return view.bind(std::move(table), m_stringPool);
+	}
+	bool useProperties(std::string_view inputString, std::string& outputString);
 	bool saveTable(const std::string tableName, const std::string tablePath);
 
 	//statics
@@ -0,0 +1,252 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <cstring>
+#include <string_view>
+
+#include "common.h"
+#include "MsiTable.h"
+#include "StringPool.h"
+#include "LogHelper.h"
+
+//type of field expected by the typed view
+enum class FieldType
+{
+	OrdString,		//ordinal string
+	String,			//ordinal or localized string
+	Short,			//2 byte number
+	Long,			//4 byte number
+	Number,			//2 or 4 byte number (width differs between schema versions)
+	Binary,			//stream (eg. "Data" in Binary table)
+};
+
+struct FieldSchema
+{
+	const char* name;
+	FieldType type;
+};
+
+/*	Schemas of well known tables. Only leading columns which we use are listed. Tables can have
+	more columns (eg. "ExtendedType" in CustomAction), they are ignored by typed views.
+*/
+struct CustomActionSchema
+{
+	static constexpr char Table_Name[] = "CustomAction";
+	enum Column : DWORD { Action, Type, Source, Target, Column_Count };
+	static constexpr FieldSchema Fields[Column_Count] = {
+		{ "Action", FieldType::OrdString },
+		{ "Type", FieldType::Number },
+		{ "Source", FieldType::OrdString },
+		{ "Target", FieldType::OrdString },
+	};
+};
+
+struct PropertySchema
+{
+	static constexpr char Table_Name[] = "Property";
+	enum Column : DWORD { Property, Value, Column_Count };
+	static constexpr FieldSchema Fields[Column_Count] = {
+		{ "Property", FieldType::String },
+		{ "Value", FieldType::String },
+	};
+};
+
+struct BinarySchema
+{
+	static constexpr char Table_Name[] = "Binary";
+	enum Column : DWORD { Name, Data, Column_Count };
+	static constexpr FieldSchema Fields[Column_Count] = {
+		{ "Name", FieldType::OrdString },
+		{ "Data", FieldType::Binary },
+	};
+};
+
+struct FileSchema
+{
+	static constexpr char Table_Name[] = "File";
+	enum Column : DWORD { File, Component, FileName, FileSize, Version, Language, Attributes, Sequence, Column_Count };
+	static constexpr FieldSchema Fields[Column_Count] = {
+		{ "File", FieldType::OrdString },
+		{ "Component_", FieldType::OrdString },
+		{ "FileName", FieldType::String },
+		{ "FileSize", FieldType::Long },
+		{ "Version", FieldType::OrdString },
+		{ "Language", FieldType::OrdString },
+		{ "Attributes", FieldType::Short },
+		{ "Sequence", FieldType::Number },
+	};
+};
+
+struct ComponentSchema
+{
+	static constexpr char Table_Name[] = "Component";
+	enum Column : DWORD { Component, ComponentId, Directory, Attributes, Condition, KeyPath, Column_Count };
+	static constexpr FieldSchema Fields[Column_Count] = {
+		{ "Component", FieldType::OrdString },
+		{ "ComponentId", FieldType::OrdString },
+		{ "Directory_", FieldType::OrdString },
+		{ "Attributes", FieldType::Short },
+		{ "Condition", FieldType::OrdString },
+		{ "KeyPath", FieldType::OrdString },
+	};
+};
+
+struct DirectorySchema
+{
+	static constexpr char Table_Name[] = "Directory";
+	enum Column : DWORD { Directory, DirectoryParent, DefaultDir, Column_Count };
+	static constexpr FieldSchema Fields[Column_Count] = {
+		{ "Directory", FieldType::OrdString },
+		{ "Directory_Parent", FieldType::OrdString },
+		{ "DefaultDir", FieldType::String },
+	};
+};
+
+struct InstallExecuteSequenceSchema
+{
+	static constexpr char Table_Name[] = "InstallExecuteSequence";
+	enum Column : DWORD { Action, Condition, Sequence, Column_Count };
+	static constexpr FieldSchema Fields[Column_Count] = {
+		{ "Action", FieldType::OrdString },
+		{ "Condition", FieldType::OrdString },
+		{ "Sequence", FieldType::Short },
+	};
+};
+
+/*	Typed view of the well known table. Column types are checked against the schema once, in bind().
+	Later fields are read by column known at compile time: pointer to the column and the field width
+	(fixed by schema for Short, Long and Binary) are already known, so reading a field doesn't check
+	column kinds. String fields use the string index size of the pool, which is the same for the whole table.
+	Unknown tables are still read by generic MsiTable accessors.
+*/
+template <class Schema>
+class TypedTableView
+{
+private:
+	std::shared_ptr<const MsiTable> m_table;
+	const StringPool* m_stringPool = nullptr;
+	const BYTE* m_columns[Schema::Column_Count] = {};
+	DWORD m_fieldSizes[Schema::Column_Count] = {};
+	DWORD m_rowCount = 0;
+
+public:
+	bool bind(std::shared_ptr<const MsiTable> table, const StringPool& stringPool)
+	{
+		const std::vector<ColumnInfo>& columns = table->getColumns();
+		if (columns.size() < Schema::Column_Count)
+		{
+			std::string msg = std::string(Schema::Table_Name) + " has less columns than expected: ";
+			LogHelper::PrintLog(LogLevel::Warning, msg.data(), static_cast<int>(columns.size()));
+			return false;
+		}
+
+		for (DWORD i = 0; i < Schema::Column_Count; i++)
+		{
+			//columns are matched by position like in msi.dll, so other name is only suspicious
+			if (columns[i].name.compare(Schema::Fields[i].name) != 0)
+			{
+				std::string msg = std::string(Schema::Table_Name) + " - unexpected column name \"" + std::string(columns[i].name)
+					+ "\". Expected: " + Schema::Fields[i].name;
+				LogHelper::PrintLog(LogLevel::Warning, msg.data());
+			}
+
+			if (!matchType(Schema::Fields[i].type, columns[i].type))
+			{
+				std::string msg = std::string(Schema::Table_Name) + " - column \"" + std::string(columns[i].name)
+					+ "\" has unexpected type";
+				LogHelper::PrintLog(LogLevel::Warning, msg.data());
+				return false;
+			}
+			m_columns[i] = table->column(i).data();
+			m_fieldSizes[i] = table->column(i).fieldSize();
+		}
+
+		m_rowCount = table->rowCount();
+		m_stringPool = &stringPool;
+		m_table = std::move(table);
+		return true;
+	}
+
+	// row must be less than rowCount()
+	template <DWORD Column>
+	DWORD get(DWORD row) const
+	{
+		static_assert(Column < Schema::Column_Count, "column out of schema");
+		constexpr FieldType Type = Schema::Fields[Column].type;
+		const BYTE* field = m_columns[Column] + static_cast<size_t>(row) * fieldSize<Column>();
+
+		DWORD value = 0;
+		if constexpr (Type == FieldType::Long)
+		{
+			::memcpy(&value, field, sizeof(DWORD));
+		}
+		else if constexpr (Type == FieldType::Short || Type == FieldType::Binary)
+		{
+			::memcpy(&value, field, sizeof(WORD));
+		}
+		else
+		{
+			::memcpy(&value, field, m_fieldSizes[Column]);
+		}
+		return value;
+	}
+
+	// empty string for index out of string pool
+	template <DWORD Column>
+	std::string_view getString(DWORD row) const
+	{
+		constexpr FieldType Type = Schema::Fields[Column].type;
+		static_assert(Type == FieldType::OrdString || Type == FieldType::String, "column isn't a string");
+		return m_stringPool->get(get<Column>(row));
+	}
+
+	DWORD rowCount() const
+	{
+		return m_rowCount;
+	}
+
+	const MsiTable& table() const
+	{
+		return *m_table;
+	}
+
+private:
+	template <DWORD Column>
+	DWORD fieldSize() const
+	{
+		constexpr FieldType Type = Schema::Fields[Column].type;
+		if constexpr (Type == FieldType::Long)
+		{
+			return sizeof(DWORD);
+		}
+		else if constexpr (Type == FieldType::Short || Type == FieldType::Binary)
+		{
+			return sizeof(WORD);
+		}
+		else
+		{
+			return m_fieldSizes[Column];
+		}
+	}
+
+	static bool matchType(FieldType fieldType, const ColumnTypeInfo& columnType)
+	{
+		switch (fieldType)
+		{
+		case FieldType::OrdString:
+			return columnType.kind == ColumnKind::OrdString;
+		case FieldType::String:
+			return columnType.kind == ColumnKind::OrdString || columnType.kind == ColumnKind::LocString;
+		case FieldType::Short:
+			return columnType.kind == ColumnKind::Number && columnType.value == sizeof(WORD);
+		case FieldType::Long:
+			return columnType.kind == ColumnKind::Number && columnType.value == sizeof(DWORD);
+		case FieldType::Number:
+			return columnType.kind == ColumnKind::Number;
+		case FieldType::Binary:
+			return columnType.kind == ColumnKind::Unknown;
+		default:
+			return false;
+		}
+	}
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+
+#include "common.h"
+
+/*	Output file written by native calls (write on posix, WriteFile on windows). Unlike std::ofstream it gives
+	the descriptor, so the data can be copied into it by the kernel (copy_file_range, sendfile) without
+	a buffer in user space.
+*/
+class OutputFile
+{
+private:
+#ifdef _WIN32
+	void* m_fileHandle = nullptr;
+#else
+	int m_fileDescriptor = -1;
+#endif
+
+public:
+	OutputFile();
+	~OutputFile();
+	OutputFile(const OutputFile&) = delete;
+	OutputFile& operator=(const OutputFile&) = delete;
+
+	bool open(const std::string& path);
+	bool openStdout();
+	bool write(const void* data, QWORD size);
+	bool close();
+	bool isOpen() const;
+
+#ifndef _WIN32
+	int descriptor() const;
+#endif
+};
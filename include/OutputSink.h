@@ -0,0 +1,92 @@
+#pragma once
+#include <set>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <functional>
+
+#include "common.h"
+#include "OutputFile.h"
+
+//file created in the output sink. Content is given in parts, the file is complete after close
+class OutputEntry
+{
+public:
+	virtual ~OutputEntry();
+
+	virtual bool write(const void* data, QWORD size) = 0;
+	virtual bool close() = 0;
+};
+
+/*	Destination of all analysis results (tables, scripts, embedded files and reports). Paths are relative to
+	the output root and use '\' as separator, like in the rest of the analyzer. Sink can be used from many
+	threads at once. finish must be called after the last file.
+*/
+class OutputSink
+{
+public:
+	virtual ~OutputSink();
+
+	virtual bool createDirectory(const std::string& path) = 0;
+	virtual bool openFile(const std::string& path, std::unique_ptr<OutputEntry>& file) = 0;
+	//size is known before the content, which is written by "writeContent" (eg. copied by the kernel)
+	virtual bool writeStreamedFile(const std::string& path, QWORD size, const std::function<bool(OutputFile&)>& writeContent) = 0;
+	virtual bool finish();
+
+	bool writeFile(const std::string& path, const void* data, QWORD size);
+};
+
+//the classic layout: each result is a separate file in the output directory
+class DirectorySink : public OutputSink
+{
+private:
+	const std::string m_root;
+
+public:
+	explicit DirectorySink(const std::string& root);
+
+	bool createDirectory(const std::string& path) override;
+	bool openFile(const std::string& path, std::unique_ptr<OutputEntry>& file) override;
+	bool writeStreamedFile(const std::string& path, QWORD size, const std::function<bool(OutputFile&)>& writeContent) override;
+
+private:
+	std::string getFullPath(const std::string& path) const;
+	bool openOutputFile(const std::string& path, OutputFile& outputFile) const;
+};
+
+/*	All results are written into one uncompressed tar (ustar) file or to stdout, so the whole analysis is one
+	sequential write without any file system metadata operations. Entries are written one at a time: files
+	opened by openFile are kept in memory until close, streamed files hold the archive during writing.
+	Long names are stored in GNU "././@LongLink" entries, sizes above 8 GB in base-256.
+*/
+class TarSink : public OutputSink
+{
+private:
+	static constexpr DWORD Block_Size = 512;
+
+	OutputFile m_output;
+	std::mutex m_mutex;
+	std::set<std::string> m_directories;
+	QWORD m_modificationTime = 0;
+	bool m_failed = false;
+
+public:
+	TarSink();
+
+	bool open(const std::string& path);
+	bool openStdout();
+
+	bool createDirectory(const std::string& path) override;
+	bool openFile(const std::string& path, std::unique_ptr<OutputEntry>& file) override;
+	bool writeStreamedFile(const std::string& path, QWORD size, const std::function<bool(OutputFile&)>& writeContent) override;
+	bool finish() override;
+
+	//used by files from openFile on close
+	bool writeEntry(const std::string& path, const void* data, QWORD size);
+
+private:
+	bool writeHeader(const std::string& name, char type, QWORD size);
+	bool writeHeaderBlock(const std::string& name, char type, QWORD size);
+	bool writePadding(QWORD size);
+	static std::string getEntryName(const std::string& path);
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+#include "common.h"
+
+enum class PowerShellActionType
+{
+	None,
+	Content,	//script is stored in the action ("\1Script\2")
+	Call,		//path of the script file is stored in the action ("\1Property\2")
+};
+
+/*	Parts of the powershell custom action data (AI_DATA_SETTER actions). Views point into the action data,
+	so nothing is copied. Data looks like:
+	"\1Params\2<params>\1Script\2<script>\1ScriptPreamble\2<preamble>" or
+	"\1Property\2<script_path>\1...\1ScriptPreamble\2<preamble>"
+*/
+struct PowerShellAction
+{
+	PowerShellActionType type = PowerShellActionType::None;
+	std::string_view params;
+	std::string_view script;	//script content or script path (depends on type)
+	std::string_view preamble;
+	bool hasParams = false;
+	bool hasPreamble = false;
+};
+
+bool parsePowerShellAction(std::string_view actionData, bool contentAllowed, PowerShellAction& action);
+void decodePS1Script(std::string_view rawScript, std::string& decodedScript);
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <string_view>
+
+#include "common.h"
+#include "MsiTable.h"
+#include "StringPool.h"
+
+//table found in "!_Tables" with its columns from "!_Columns"
+struct TableDescriptor
+{
+	std::string_view name;		//view into the string pool
+	DWORD nameIndex;			//string index of the name
+	DWORD firstColumn;			//index of the first column in SchemaCatalog columns
+	DWORD columnCount;
+	DWORD rowByteSize;			//sum of field sizes of all columns
+};
+
+/*	Schema of all tables, built once after "!_Columns" is read and later only read. Tables are kept
+	in one array sorted by name and their columns in the second one, so each table is a span of columns
+	with precomputed field sizes and offsets. Tables can be found by name in O(1) thanks to
+	the open addressing hash table.
+*/
+class SchemaCatalog
+{
+private:
+	static constexpr DWORD Empty_Slot = 0xFFFFFFFF;
+
+	std::vector<TableDescriptor> m_tables;		//sorted by name
+	std::vector<ColumnDescriptor> m_columns;
+	std::vector<DWORD> m_slots;					//index of the table or Empty_Slot
+	QWORD m_slotMask = 0;
+
+public:
+	bool build(const StringPool& stringPool, const std::vector<DWORD>& tableNameIndices, const BYTE* columnsStream, QWORD columnsStreamSize);
+	void clear();
+	const TableDescriptor* find(std::string_view tableName) const;
+	const ColumnDescriptor* getColumns(const TableDescriptor& table) const;
+
+	//getter
+	const std::vector<TableDescriptor>& getTables() const;
+
+private:
+	void buildHashTable();
+};
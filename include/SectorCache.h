@@ -0,0 +1,69 @@
+#pragma once
+#include <list>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <condition_variable>
+
+#include "common.h"
+#include "ByteSource.h"
+
+//counters of the sector cache. "bytesRead" are bytes taken from the source, "bytesRequested" are bytes asked by readers
+struct SectorCacheStats
+{
+	QWORD hits;
+	QWORD misses;
+	QWORD bytesRead;
+	QWORD bytesRequested;
+};
+
+/*	LRU cache of fixed size blocks placed between CfbExtractor and the byte source. The same tables are read
+	several times during analysis, so with pread (or spooled file) source they are taken from the disk only once.
+	Reads bigger than a quarter of the cache (eg. embedded cabinets) bypass it, so they don't evict everything.
+	Cache can be used from many threads at once. The source is read without the lock, so misses of different
+	threads are read in parallel.
+*/
+class SectorCache : public ByteSource
+{
+public:
+	static constexpr DWORD Block_Size = 0x1000;
+
+private:
+	struct Block
+	{
+		QWORD index;
+		std::unique_ptr<BYTE[]> data;
+	};
+
+	const ByteSource* m_source = nullptr;
+	QWORD m_capacityBlocks = 0;
+
+	mutable std::mutex m_mutex;
+	mutable std::list<Block> m_blocks;		//the most recently used first
+	mutable std::unordered_map<QWORD, std::list<Block>::iterator> m_blockMap;
+	mutable std::unordered_set<QWORD> m_blocksInFlight;		//blocks being read from the source right now
+	mutable std::condition_variable m_blockReady;
+
+	mutable std::atomic<QWORD> m_hits{ 0 };
+	mutable std::atomic<QWORD> m_misses{ 0 };
+	mutable std::atomic<QWORD> m_bytesRead{ 0 };
+	mutable std::atomic<QWORD> m_bytesRequested{ 0 };
+
+public:
+	void init(const ByteSource* source, QWORD capacity);
+	void setCapacity(QWORD capacity);
+	void noteDirectAccess(QWORD size) const;
+	SectorCacheStats getStats() const;
+
+	QWORD size() const override;
+	bool read(QWORD offset, void* buffer, QWORD size) const override;
+	const BYTE* data() const override;
+	bool supportsFileCopy() const override;
+	bool copyToFile(QWORD offset, QWORD size, OutputFile& output) const override;
+
+private:
+	bool readBlock(QWORD blockIndex, QWORD offsetInBlock, BYTE* buffer, QWORD size) const;
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include "common.h"
+
+/*	Translates sector index into offset in the file. Regular sectors are placed one after the other
+	behind the header. Mini sectors are placed inside regular sectors of the mini stream (chain of
+	the root entry), so they are resolved through the list of these sectors and the mini stream
+	doesn't have to be copied into memory.
+*/
+class SectorLocator
+{
+private:
+	DWORD m_sectionSize = 0;
+	DWORD m_containerSectionSize = 0;
+	const DWORD* m_containerSectors = nullptr;	//regular sectors of mini stream, nullptr for regular sectors
+	DWORD m_containerSectorCount = 0;
+
+public:
+	void initRegular(DWORD sectionSize);
+	void initMini(DWORD miniSectionSize, DWORD sectionSize, const DWORD* miniStreamSectors, DWORD miniStreamSectorCount);
+	bool getOffset(DWORD sector, QWORD& offset) const;
+
+	//getters
+	DWORD sectionSize() const;
+	bool isMini() const;
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <set>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include "common.h"
+#include "ThreadPool.h"
+
+//outcome of one analysis stage
+enum class StageStatus
+{
+	Pending,
+	Succeeded,
+	Failed,
+	Skipped		//one of dependencies failed, so stage wasn't run
+};
+
+/*	Analysis stages declared as a dependency graph. Stage is run when all its dependencies succeeded, so
+	independent stages overlap on the thread pool. Stages inside can use the same pool (parallelFor).
+	Calling thread takes part in the work, stages ready at the same time are started in the order of declaration.
+	Without the pool stages are run one by one in the calling thread.
+	Usage: addStage for each stage (dependencies must be added before), then run.
+*/
+class StageGraph
+{
+public:
+	typedef DWORD StageId;
+
+private:
+	struct Stage
+	{
+		std::string name;
+		std::function<bool()> action;
+		std::vector<StageId> dependents;
+		DWORD pendingDependencies = 0;
+		StageStatus status = StageStatus::Pending;
+	};
+
+	//shared with the pool tasks, they can start after run returned
+	struct RunState
+	{
+		std::mutex mutex;
+		std::condition_variable stageFinished;
+		std::set<StageId> readyStages;
+		DWORD finishedCount = 0;
+	};
+
+	std::vector<Stage> m_stages;
+
+public:
+	StageGraph();
+
+	StageId addStage(const std::string& name, std::function<bool()> action, const std::vector<StageId>& dependencies = {});
+	bool run(ThreadPool* threadPool);
+
+	//getters
+	StageStatus getStatus(StageId stage) const;
+
+private:
+	void runStage(const std::shared_ptr<RunState>& state, StageId stage, ThreadPool* threadPool);
+	bool executeStage(StageId stage);
+	DWORD finishStage(RunState& state, StageId stage, bool succeeded);
+	DWORD skipDependents(StageId stage);
+	void submitHelpers(const std::shared_ptr<RunState>& state, DWORD count, ThreadPool* threadPool);
+	static bool takeReadyStage(RunState& state, StageId& stage);
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include "common.h"
+#include "ByteSource.h"
+#include "ChainWalker.h"
+#include "SectorLocator.h"
+
+/*	Sequential reader of one cfb stream. FAT (or miniFAT) chain is walked lazily during reading, so
+	memory usage depends only on the buffer given by the caller, not on the stream size.
+	Reader is created by CfbExtractor::openStream.
+*/
+class StreamReader
+{
+private:
+	const ByteSource* m_input = nullptr;
+	SectorLocator m_locator;
+
+	QWORD m_streamSize = 0;
+	QWORD m_position = 0;
+	ChainWalker m_walker;
+	DWORD m_currentSector = 0;
+	QWORD m_currentSectorOffset = 0;
+	DWORD m_offsetInSector = 0;
+	bool m_failed = false;
+
+public:
+	StreamReader();
+	void init(const ByteSource* input, const SectorLocator& locator, const DWORD* sectionInfoArray, 
+		DWORD sectionArraySize, DWORD firstSector, QWORD streamSize);
+
+	QWORD read(BYTE* buffer, QWORD size);
+	bool skip(QWORD size);
+
+	//getters
+	QWORD size() const;
+	QWORD position() const;
+	bool eof() const;
+	bool good() const;
+
+private:
+	bool advance(QWORD size, BYTE* buffer);
+	bool nextSector();
+};
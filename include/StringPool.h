@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <string_view>
+
+#include "common.h"
+#include "CfbExtractor.h"
+#include "ThreadPool.h"
+
+/*	All strings of msi database. "!_StringData" is kept as one buffer (very often only a view into the mapped file)
+	and strings are only offsets into it, so loading doesn't allocate memory per string. Strings are given as
+	std::string_view, which are valid as long as the pool lives.
+*/
+class StringPool
+{
+private:
+	//flag in the "!_StringPool" header. Database with so many strings that index doesn't fit in WORD uses 3 byte references
+	static constexpr DWORD Long_String_Refs_Flag = 0x80000000;
+
+	//big pools are split into chunks of this many entries and decoded in parallel
+	static constexpr DWORD Entries_In_Chunk = 0x10000;
+
+	//part of "!_StringPool" decoded by one task
+	struct PoolChunk
+	{
+		DWORD beginEntry;
+		DWORD endEntry;
+		bool startsWithLength;		//first entry is the length of long string started in the previous chunk
+		bool endsWithMarker;		//last entry starts long string, so the length is in the next chunk
+		QWORD dataSize;				//bytes of "!_StringData" used by strings of this chunk
+		DWORD stringCount;
+		QWORD firstDataOffset;		//prefix sums of the previous chunks
+		DWORD firstStringIndex;
+	};
+
+	StreamBuffer m_stringData;
+	std::vector<DWORD> m_offsets;		//string "i" is [m_offsets[i], m_offsets[i + 1])
+	DWORD m_codepage = 0;
+	DWORD m_stringRefSize = sizeof(WORD);
+
+public:
+	bool build(StreamBuffer&& stringData, const StreamBuffer& stringPool, ThreadPool* threadPool = nullptr);
+	void clear();
+
+	DWORD size() const;
+	std::string_view get(DWORD index) const;
+	DWORD codepage() const;
+	DWORD stringRefSize() const;
+	DWORD readStringRef(const BYTE* field) const;
+
+private:
+	static void scanChunk(const DWORD* poolEntries, PoolChunk& chunk, DWORD* offsets);
+};
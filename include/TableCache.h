@@ -0,0 +1,60 @@
+#pragma once
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "common.h"
+#include "MsiTable.h"
+
+//counters of the table cache. Each miss means that table was decoded from the stream, "evicted" were dropped to keep the budget
+struct TableCacheStats
+{
+	QWORD hits;
+	QWORD misses;
+	QWORD evicted;
+	QWORD memoryUsage;
+};
+
+/*	LRU cache of parsed tables. The same tables (eg. Property, CustomAction) are needed by several analysis
+	stages, so each of them is decoded once. Tables are shared by pointer, so evicted table stays valid
+	for stages which still use it. Memory budget counts only memory owned by tables (views into the mapped
+	file are almost free). Table bigger than the whole budget isn't cached.
+	Cache can be used from many threads at once.
+*/
+class TableCache
+{
+public:
+	static constexpr QWORD Default_Capacity = 64 * 1024 * 1024;
+
+private:
+	struct Entry
+	{
+		std::string name;
+		std::shared_ptr<const MsiTable> table;
+		QWORD memoryUsage;
+	};
+
+	QWORD m_capacity = Default_Capacity;
+	QWORD m_memoryUsage = 0;
+
+	mutable std::mutex m_mutex;
+	mutable std::list<Entry> m_entries;		//the most recently used first
+	mutable std::unordered_map<std::string, std::list<Entry>::iterator> m_entryMap;
+
+	mutable QWORD m_hits = 0;
+	mutable QWORD m_misses = 0;
+	QWORD m_evicted = 0;
+
+public:
+	void setCapacity(QWORD capacity);
+	std::shared_ptr<const MsiTable> find(const std::string& tableName) const;
+	std::shared_ptr<const MsiTable> insert(const std::string& tableName, std::shared_ptr<const MsiTable> table);
+	void evict(const std::string& tableName);
+	void clear();
+	TableCacheStats getStats() const;
+
+private:
+	void evictOverBudget();
+};
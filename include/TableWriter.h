@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <string_view>
+
+#include "common.h"
+#include "MsiTable.h"
+#include "OutputSink.h"
+
+//formats of saved tables
+enum class TableFormat
+{
+	Text,		//columns separated by " \t|\t ", rows numbered (default)
+	Csv,		//RFC 4180
+	Tsv,		//tabs, newlines and backslashes in values are escaped with '\'
+	JsonLines	//one json object per row, column names are keys
+};
+
+/*	Serializes one table to the file. Cells are formatted into a big user space buffer (numbers with
+	std::to_chars), so the file is written in a few large writes instead of one per cell and there is no
+	flush after each row. Usage: open, then for each row beginRow, one write* call per column, endRow, and close.
+*/
+class TableWriter
+{
+public:
+	static constexpr DWORD Default_Buffer_Size = 256 * 1024;
+
+private:
+	std::unique_ptr<OutputEntry> m_output;
+	std::vector<char> m_buffer;
+	size_t m_used = 0;
+	bool m_failed = false;
+
+	TableFormat m_format = TableFormat::Text;
+	const std::vector<ColumnInfo>* m_columns = nullptr;
+	QWORD m_rowIndex = 0;
+	DWORD m_columnIndex = 0;
+
+	//json is utf-8, strings are converted from the msi codepage
+	DWORD m_codepage = 0;
+#ifndef _WIN32
+	void* m_converter = nullptr;	//iconv_t
+#endif
+	std::string m_transcoded;
+
+public:
+	TableWriter();
+	~TableWriter();
+
+	bool open(OutputSink& sink, const std::string& path, TableFormat format, const std::vector<ColumnInfo>& columns,
+		DWORD codepage = 0, DWORD bufferSize = Default_Buffer_Size);
+	bool close();
+
+	void beginRow();
+	void writeString(std::string_view value);
+	void writeNumber(DWORD value);
+	void writeBinary(DWORD value);
+	void endRow();
+
+	static bool parseFormat(std::string_view name, TableFormat& format);
+	static const char* fileExtension(TableFormat format);
+
+private:
+	void writeHeader();
+	void beginCell();
+	void writeEscaped(std::string_view value);
+	bool openConverter();
+	void closeConverter();
+	bool transcode(std::string_view value, std::string& output);
+	void writeInteger(DWORD value, int base);
+	void append(std::string_view text);
+	void append(char c);
+	char* reserve(size_t size);
+	void flush();
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include "common.h"
+
+/*	Simple pool of worker threads. Tasks are taken in FIFO order.
+	parallelFor splits the range into chunks and the calling thread takes part in the work, so it can be
+	used also from inside a task without deadlock (in the worst case caller does everything alone).
+*/
+class ThreadPool
+{
+private:
+	std::vector<std::thread> m_threads;
+	std::deque<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_taskReady;
+	bool m_stopping = false;
+
+public:
+	explicit ThreadPool(DWORD threadCount = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()> task);
+	void parallelFor(QWORD count, const std::function<void(QWORD index)>& body);
+
+	//getter
+	DWORD threadCount() const;
+
+private:
+	void workerLoop();
+};
@@ -0,0 +1,19 @@
+#pragma once
+#include "common.h"
+
+//implementation of unpackFields chosen at runtime
+enum class UnpackKernel
+{
+	Scalar,
+	Sse2,
+	Avx2
+};
+
+/*	Widens "count" consecutive fields of "fieldSize" bytes (2, 3 or 4, little endian) into DWORD's.
+	Table columns are stored as packed arrays of such fields, so whole column (or its part) is unpacked
+	at once instead of one field at a time. WORD fields are widened with SSE2 or AVX2 when the cpu supports it.
+*/
+void unpackFields(const BYTE* input, DWORD fieldSize, DWORD count, DWORD* output);
+//the same with the given kernel (benchmark compares them). Kernel must not be above getUnpackKernel()
+void unpackFields(UnpackKernel kernel, const BYTE* input, DWORD fieldSize, DWORD count, DWORD* output);
+UnpackKernel getUnpackKernel();
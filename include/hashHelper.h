@@ -0,0 +1,16 @@
+#pragma once
+#include <string_view>
+
+#include "common.h"
+
+// FNV-1a. Used by the open addressing hash tables of names (DirectoryIndex, SchemaCatalog)
+inline QWORD hashString(std::string_view text)
+{
+	QWORD hash = 0xCBF29CE484222325;
+	for (char c : text)
+	{
+		hash ^= static_cast<BYTE>(c);
+		hash *= 0x100000001B3;
+	}
+	return hash;
+}
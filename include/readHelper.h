@@ -1,123 +1,130 @@
 #pragma once
-#include <fstream>
+#include <vector>
 #include <cstring>
+#include <string>
+#include <algorithm>
 
 #include "common.h"
 #include "LogHelper.h"
+#include "ByteSource.h"
+#include "ChainWalker.h"
+#include "SectorLocator.h"
 
-// read simple type variable from file stream
+// read simple type variable from byte source (mapped file, file, memory buffer, ...)
 template <class T>
-bool readVariable(std::ifstream& inputFile, T& data, DWORD offset = -1)
+bool readVariable(const ByteSource& source, T& data, QWORD offset = 0)
 {
-	if (!inputFile)
+	if (offset > source.size() || source.size() - offset < sizeof(T) || !source.read(offset, &data, sizeof(T)))
 	{
-		LogHelper::PrintLog(LogLevel::Error, "Stream is closed");
-		return false;
-	}
-
-	if ((int)offset != -1)
-	{
-		inputFile.seekg(offset, std::ios::beg);
-	}
-
-	inputFile.read((char*)&data, sizeof(T));
-	if (!inputFile)
-	{
-		LogHelper::PrintLog(LogLevel::Error, "Readed characters: ", static_cast<int>(inputFile.gcount()));
+		std::string msg = "readVariable - read out of bound. Offset: " + std::to_string(offset);
+		LogHelper::PrintLog(LogLevel::Error, msg.data());
 		return false;
 	}
 	return true;
 }
 
-// read simple type array from file stream
+// read simple type array from byte source. "size" is a count of elements
 template <class T>
-bool readArray(std::ifstream& inputFile, T* data, DWORD size, DWORD offset = -1)
+bool readArray(const ByteSource& source, T* data, QWORD size, QWORD offset = 0)
 {
-	if (!inputFile)
+	const QWORD bytesToRead = static_cast<QWORD>(sizeof(T)) * size;
+	if (offset > source.size() || source.size() - offset < bytesToRead || !source.read(offset, data, bytesToRead))
 	{
-		LogHelper::PrintLog(LogLevel::Error, "Stream is closed");
-		return false;
-	}
-
-	if ((int)offset != -1)
-	{
-		inputFile.seekg(offset, std::ios::beg);
-	}
-
-	inputFile.read((char*)data, sizeof(T)*size);
-	if (!inputFile)
-	{
-		LogHelper::PrintLog(LogLevel::Error, "Readed characters: ", static_cast<int>(inputFile.gcount()));
+		std::string msg = "readArray - read out of bound. Offset: " + std::to_string(offset);
+		LogHelper::PrintLog(LogLevel::Error, msg.data());
 		return false;
 	}
 	return true;
 }
 
-// read simple type array from chunk of data
-template <class T>
-bool readArray(BYTE* arrayStream, T* data, DWORD size, DWORD offset = -1)
+//part of the stream which is stored in consecutive bytes of the file
+struct FileExtent
 {
-	if (!arrayStream)
-	{
-		LogHelper::PrintLog(LogLevel::Error, "readArray - arrayStream is nullptr");
-		return false;
-	}
-
-	if ((int)offset != -1)
-	{
-		arrayStream += offset;
-	}
-
-	::memcpy(data, arrayStream, size);
-
-	return true;
-}
+	QWORD offset;
+	QWORD size;
+};
 
-/*	This function is specific for compound file binary. It helps read sections (eg. miniStream).
-	It is universal function, so we can read from file stream and from array,the output can be 
-	an array of different types and we have option to read from miniStream.
+/*	Walks the sector chain once and merges physically consecutive sectors into extents. Most of streams
+	are stored in one or a few extents, so later the stream can be read with one copy per extent instead of one per sector.
 */
-template <typename T, typename U>
-bool readChunkOfDataFromCfb(T& inputStream, U * outputStream, DWORD sectorIndex, QWORD streamToReadSize,
-	DWORD sectionSize, DWORD* sectionInfoArray, DWORD sectionArraySize, bool readFromMiniStream = false)
+inline bool buildFileExtents(DWORD sectorIndex, QWORD streamToReadSize, const SectorLocator& locator, const DWORD* sectionInfoArray, 
+	DWORD sectionArraySize, std::vector<FileExtent>& extents)
 {
-	const DWORD elementsInSection = sectionSize / sizeof(U);
-	DWORD streamSecCount = static_cast<DWORD>(streamToReadSize) / sectionSize;
+	extents.clear();
+	const DWORD sectionSize = locator.sectionSize();
 
-	if (streamToReadSize % sectionSize > 0)
+	ChainWalker walker(sectionInfoArray, sectionArraySize, sectorIndex);
+	for (QWORD bytesToEnd = streamToReadSize; bytesToEnd > 0;)
 	{
-		streamSecCount++;
-	}
-
-	DWORD bytesToEnd = static_cast<DWORD>(streamToReadSize);
-	for (DWORD i = 0; i < streamSecCount; i++)
-	{
-		DWORD bytesToReadInThisIter = sectionSize;
-		if (bytesToEnd < sectionSize)
+		if (!walker.next(sectorIndex))
 		{
-			bytesToReadInThisIter = bytesToEnd;
+			if (walker.error() == ChainError::None)
+			{
+				LogHelper::PrintLog(LogLevel::Error, "buildFileExtents - chain is shorter than stream");
+			}
+			walker.logError("buildFileExtents");
+			return false;
 		}
 
-		if (sectorIndex >= sectionArraySize)
+		QWORD sectorOffset = 0;
+		if (!locator.getOffset(sectorIndex, sectorOffset))
 		{
-			LogHelper::PrintLog(LogLevel::Error, "\"sectorIndex\" index out of bound: ", sectorIndex);
+			LogHelper::PrintLog(LogLevel::Error, "buildFileExtents - sector is behind the end of mini stream: ", sectorIndex);
 			return false;
 		}
 
-		if (!readArray(inputStream, outputStream + i * elementsInSection, bytesToReadInThisIter / sizeof(U), sectionSize * (sectorIndex + !readFromMiniStream)))
+		const QWORD bytesInSector = (std::min)(bytesToEnd, static_cast<QWORD>(sectionSize));
+		if (!extents.empty() && extents.back().offset + extents.back().size == sectorOffset)
 		{
-			LogHelper::PrintLog(LogLevel::Error, "readChunkOfDataFromCfb - read error. Sec Index: ", sectorIndex);
-			return false;
+			extents.back().size += bytesInSector;
+		}
+		else
+		{
+			extents.push_back({ sectorOffset, bytesInSector });
 		}
+		bytesToEnd -= bytesInSector;
+	}
 
-		sectorIndex = sectionInfoArray[sectorIndex];
-		bytesToEnd -= sectionSize;
+	if (walker.currentSector() != ENDOFCHAIN)
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "last index should be ENDOFCHAIN but isn't. Is: ", walker.currentSector());
 	}
 
-	if (sectorIndex != ENDOFCHAIN)
+	return true;
+}
+
+// copies the stream described by file extents into output. Each extent is copied at once
+template <typename U>
+bool readFileExtents(const ByteSource& source, U * outputStream, const std::vector<FileExtent>& extents)
+{
+	BYTE* output = reinterpret_cast<BYTE*>(outputStream);
+	for (const FileExtent& extent : extents)
 	{
-		LogHelper::PrintLog(LogLevel::Warning, "last index should be ENDOFCHAIN but isn't. Is: ", sectorIndex);
+		if (!readArray(source, output, extent.size, extent.offset))
+		{
+			std::string msg = "readFileExtents - read error. Offset: " + std::to_string(extent.offset);
+			LogHelper::PrintLog(LogLevel::Error, msg.data());
+			return false;
+		}
+		output += extent.size;
 	}
 
 	return true;
-}
\ No newline at end of file
+}
+
+/*	This function is specific for compound file binary. It helps read sections (eg. miniFat).
+	Input is the byte source of the whole file, the output can be an array of different types.
+	Locator decides if sectors are regular or mini sectors.
+*/
+template <typename U>
+bool readChunkOfDataFromCfb(const ByteSource& source, U * outputStream, DWORD sectorIndex, QWORD streamToReadSize,
+	const SectorLocator& locator, const DWORD* sectionInfoArray, DWORD sectionArraySize)
+{
+	std::vector<FileExtent> extents;
+	if (!buildFileExtents(sectorIndex, streamToReadSize, locator, sectionInfoArray, sectionArraySize, extents))
+	{
+		return false;
+	}
+
+	return readFileExtents(source, outputStream, extents);
+}
@@ -0,0 +1,44 @@
+#include "ByteBudget.h"
+
+ByteBudget::ByteBudget(QWORD limit) : m_limit(limit)
+{
+
+}
+
+void ByteBudget::setLimit(QWORD limit)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_limit = limit;
+	}
+	m_released.notify_all();
+}
+
+void ByteBudget::acquire(QWORD size)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_released.wait(lock, [this, size]()
+	{
+		return m_inUse == 0 || (m_inUse <= m_limit && m_limit - m_inUse >= size);
+	});
+	m_inUse += size;
+}
+
+void ByteBudget::release(QWORD size)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_inUse -= size;
+	}
+	m_released.notify_all();
+}
+
+ByteBudgetGuard::ByteBudgetGuard(ByteBudget& budget, QWORD size) : m_budget(budget), m_size(size)
+{
+	m_budget.acquire(m_size);
+}
+
+ByteBudgetGuard::~ByteBudgetGuard()
+{
+	m_budget.release(m_size);
+}
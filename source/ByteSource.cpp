@@ -0,0 +1,456 @@
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "ByteSource.h"
+#include "OutputFile.h"
+#include "LogHelper.h"
+
+ByteSource::~ByteSource()
+{
+
+}
+
+const BYTE* ByteSource::data() const
+{
+	return nullptr;
+}
+
+bool ByteSource::supportsFileCopy() const
+{
+	return false;
+}
+
+bool ByteSource::copyToFile(QWORD offset, QWORD size, OutputFile& output) const
+{
+	return false;
+}
+
+void MemoryByteSource::setView(const BYTE* data, QWORD size)
+{
+	m_ownedData.clear();
+	m_data = data;
+	m_size = size;
+}
+
+void MemoryByteSource::assign(std::vector<BYTE>&& data)
+{
+	m_ownedData = std::move(data);
+	m_data = m_ownedData.data();
+	m_size = m_ownedData.size();
+}
+
+QWORD MemoryByteSource::size() const
+{
+	return m_size;
+}
+
+bool MemoryByteSource::read(QWORD offset, void* buffer, QWORD size) const
+{
+	if (offset > m_size || m_size - offset < size)
+	{
+		return false;
+	}
+
+	::memcpy(buffer, m_data + offset, static_cast<size_t>(size));
+	return true;
+}
+
+const BYTE* MemoryByteSource::data() const
+{
+	return m_data;
+}
+
+FileByteSource::FileByteSource()
+{
+
+}
+
+FileByteSource::~FileByteSource()
+{
+	close();
+}
+
+#ifdef _WIN32
+bool FileByteSource::open(const std::string& path)
+{
+	close();
+
+	HANDLE fileHandle = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "CreateFile failed. Error: ", static_cast<int>(::GetLastError()));
+		return false;
+	}
+	m_fileHandle = fileHandle;
+
+	LARGE_INTEGER fileSize = { 0 };
+	if (!::GetFileSizeEx(fileHandle, &fileSize))
+	{
+		LogHelper::PrintLog(LogLevel::Error, "GetFileSizeEx failed. Error: ", static_cast<int>(::GetLastError()));
+		close();
+		return false;
+	}
+
+	m_size = static_cast<QWORD>(fileSize.QuadPart);
+	return true;
+}
+
+bool FileByteSource::createTemporary()
+{
+	close();
+
+	char tempDir[MAX_PATH + 1] = { 0 };
+	char tempPath[MAX_PATH + 1] = { 0 };
+	if (::GetTempPathA(MAX_PATH, tempDir) == 0 || ::GetTempFileNameA(tempDir, "msi", 0, tempPath) == 0)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "Can't get temporary file name. Error: ", static_cast<int>(::GetLastError()));
+		return false;
+	}
+
+	HANDLE fileHandle = ::CreateFileA(tempPath, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "CreateFile failed. Error: ", static_cast<int>(::GetLastError()));
+		return false;
+	}
+
+	m_fileHandle = fileHandle;
+	m_size = 0;
+	return true;
+}
+
+bool FileByteSource::append(const BYTE* data, QWORD size)
+{
+	while (size > 0)
+	{
+		const DWORD bytesToWrite = static_cast<DWORD>((std::min)(size, static_cast<QWORD>(0x40000000)));
+		OVERLAPPED overlapped = { 0 };
+		overlapped.Offset = static_cast<DWORD>(m_size);
+		overlapped.OffsetHigh = static_cast<DWORD>(m_size >> 32);
+
+		DWORD writtenBytes = 0;
+		if (!::WriteFile(m_fileHandle, data, bytesToWrite, &writtenBytes, &overlapped) || writtenBytes == 0)
+		{
+			LogHelper::PrintLog(LogLevel::Error, "WriteFile failed. Error: ", static_cast<int>(::GetLastError()));
+			return false;
+		}
+
+		data += writtenBytes;
+		size -= writtenBytes;
+		m_size += writtenBytes;
+	}
+	return true;
+}
+
+void FileByteSource::close()
+{
+	if (m_fileHandle)
+		::CloseHandle(m_fileHandle);
+
+	m_fileHandle = nullptr;
+	m_size = 0;
+}
+
+bool FileByteSource::read(QWORD offset, void* buffer, QWORD size) const
+{
+	if (!m_fileHandle || offset > m_size || m_size - offset < size)
+	{
+		return false;
+	}
+
+	BYTE* output = static_cast<BYTE*>(buffer);
+	while (size > 0)
+	{
+		const DWORD bytesToRead = static_cast<DWORD>((std::min)(size, static_cast<QWORD>(0x40000000)));
+		OVERLAPPED overlapped = { 0 };
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+		DWORD readBytes = 0;
+		if (!::ReadFile(m_fileHandle, output, bytesToRead, &readBytes, &overlapped) || readBytes == 0)
+		{
+			LogHelper::PrintLog(LogLevel::Error, "ReadFile failed. Error: ", static_cast<int>(::GetLastError()));
+			return false;
+		}
+
+		output += readBytes;
+		offset += readBytes;
+		size -= readBytes;
+	}
+	return true;
+}
+#else
+bool FileByteSource::open(const std::string& path)
+{
+	close();
+
+	m_fileDescriptor = ::open(path.c_str(), O_RDONLY);
+	if (m_fileDescriptor < 0)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "open failed. Errno: ", errno);
+		return false;
+	}
+
+	struct stat fileStat = { 0 };
+	if (::fstat(m_fileDescriptor, &fileStat) != 0)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "fstat failed. Errno: ", errno);
+		close();
+		return false;
+	}
+
+	m_size = static_cast<QWORD>(fileStat.st_size);
+	return true;
+}
+
+bool FileByteSource::createTemporary()
+{
+	close();
+
+	//tmpfile is already unlinked, so it disappears when the last descriptor is closed
+	FILE* tempFile = ::tmpfile();
+	if (!tempFile)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "tmpfile failed. Errno: ", errno);
+		return false;
+	}
+
+	m_fileDescriptor = ::dup(::fileno(tempFile));
+	::fclose(tempFile);
+	if (m_fileDescriptor < 0)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "dup failed. Errno: ", errno);
+		return false;
+	}
+
+	m_size = 0;
+	return true;
+}
+
+bool FileByteSource::append(const BYTE* data, QWORD size)
+{
+	while (size > 0)
+	{
+		const ssize_t writtenBytes = ::pwrite(m_fileDescriptor, data, static_cast<size_t>((std::min)(size, static_cast<QWORD>(0x40000000))), static_cast<off_t>(m_size));
+		if (writtenBytes <= 0)
+		{
+			if (writtenBytes < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			LogHelper::PrintLog(LogLevel::Error, "pwrite failed. Errno: ", errno);
+			return false;
+		}
+
+		data += writtenBytes;
+		size -= writtenBytes;
+		m_size += writtenBytes;
+	}
+	return true;
+}
+
+void FileByteSource::close()
+{
+	if (m_fileDescriptor >= 0)
+		::close(m_fileDescriptor);
+
+	m_fileDescriptor = -1;
+	m_size = 0;
+}
+
+bool FileByteSource::read(QWORD offset, void* buffer, QWORD size) const
+{
+	if (m_fileDescriptor < 0 || offset > m_size || m_size - offset < size)
+	{
+		return false;
+	}
+
+	BYTE* output = static_cast<BYTE*>(buffer);
+	while (size > 0)
+	{
+		const ssize_t readBytes = ::pread(m_fileDescriptor, output, static_cast<size_t>((std::min)(size, static_cast<QWORD>(0x40000000))), static_cast<off_t>(offset));
+		if (readBytes <= 0)
+		{
+			if (readBytes < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			LogHelper::PrintLog(LogLevel::Error, "pread failed. Errno: ", errno);
+			return false;
+		}
+
+		output += readBytes;
+		offset += readBytes;
+		size -= readBytes;
+	}
+	return true;
+}
+#endif
+
+#ifdef __linux__
+bool FileByteSource::supportsFileCopy() const
+{
+	return m_fileDescriptor >= 0;
+}
+
+/*	Bytes are copied by copy_file_range (it can even share blocks on some file systems). If it isn't supported
+	for these files (eg. older kernel or different file systems), sendfile is used.
+*/
+bool FileByteSource::copyToFile(QWORD offset, QWORD size, OutputFile& output) const
+{
+	if (m_fileDescriptor < 0 || offset > m_size || m_size - offset < size)
+	{
+		return false;
+	}
+
+	bool useCopyFileRange = true;
+	while (size > 0)
+	{
+		const size_t bytesToCopy = static_cast<size_t>((std::min)(size, static_cast<QWORD>(0x40000000)));
+		ssize_t copiedBytes = 0;
+		if (useCopyFileRange)
+		{
+			loff_t inputOffset = static_cast<loff_t>(offset);
+			copiedBytes = ::copy_file_range(m_fileDescriptor, &inputOffset, output.descriptor(), nullptr, bytesToCopy, 0);
+			if (copiedBytes < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP))
+			{
+				useCopyFileRange = false;
+				continue;
+			}
+		}
+		else
+		{
+			off_t inputOffset = static_cast<off_t>(offset);
+			copiedBytes = ::sendfile(output.descriptor(), m_fileDescriptor, &inputOffset, bytesToCopy);
+		}
+
+		if (copiedBytes <= 0)
+		{
+			if (copiedBytes < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			LogHelper::PrintLog(LogLevel::Error, useCopyFileRange ? "copy_file_range failed. Errno: " : "sendfile failed. Errno: ", errno);
+			return false;
+		}
+
+		offset += copiedBytes;
+		size -= copiedBytes;
+	}
+	return true;
+}
+#else
+bool FileByteSource::supportsFileCopy() const
+{
+	return false;
+}
+
+bool FileByteSource::copyToFile(QWORD offset, QWORD size, OutputFile& output) const
+{
+	return false;
+}
+#endif
+
+QWORD FileByteSource::size() const
+{
+	return m_size;
+}
+
+bool SpooledByteSource::open(FILE* input, QWORD memoryLimit)
+{
+	if (!input)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "SpooledByteSource - input is nullptr");
+		return false;
+	}
+
+#ifdef _WIN32
+	//stdin is opened in text mode on windows
+	::_setmode(::_fileno(input), _O_BINARY);
+#endif
+
+	constexpr size_t Chunk_Size = 1024 * 1024;
+	std::vector<BYTE> buffer;
+	std::vector<BYTE> chunk(Chunk_Size);
+	m_spilled = false;
+
+	while (true)
+	{
+		const size_t readBytes = ::fread(chunk.data(), 1, chunk.size(), input);
+		if (readBytes == 0)
+		{
+			break;
+		}
+
+		if (!m_spilled && buffer.size() + readBytes > memoryLimit)
+		{
+			LogHelper::PrintLog(LogLevel::Info, "Input is too big to be kept in memory. It is spooled to the temporary file");
+			ASSERT_BOOL(m_file.createTemporary());
+			ASSERT_BOOL(m_file.append(buffer.data(), buffer.size()));
+			std::vector<BYTE>().swap(buffer);
+			m_spilled = true;
+		}
+
+		if (m_spilled)
+		{
+			ASSERT_BOOL(m_file.append(chunk.data(), readBytes));
+		}
+		else
+		{
+			buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + readBytes);
+		}
+	}
+
+	if (::ferror(input))
+	{
+		LogHelper::PrintLog(LogLevel::Error, "SpooledByteSource - read error");
+		return false;
+	}
+
+	if (!m_spilled)
+	{
+		m_memory.assign(std::move(buffer));
+	}
+	return true;
+}
+
+QWORD SpooledByteSource::size() const
+{
+	return m_spilled ? m_file.size() : m_memory.size();
+}
+
+bool SpooledByteSource::read(QWORD offset, void* buffer, QWORD size) const
+{
+	return m_spilled ? m_file.read(offset, buffer, size) : m_memory.read(offset, buffer, size);
+}
+
+const BYTE* SpooledByteSource::data() const
+{
+	return m_spilled ? nullptr : m_memory.data();
+}
+
+bool SpooledByteSource::supportsFileCopy() const
+{
+	return m_spilled && m_file.supportsFileCopy();
+}
+
+bool SpooledByteSource::copyToFile(QWORD offset, QWORD size, OutputFile& output) const
+{
+	return m_spilled && m_file.copyToFile(offset, size, output);
+}
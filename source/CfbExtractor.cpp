@@ -1,9 +1,47 @@
-#include <fstream>
+#include <algorithm>
 
 #include "CfbExtractor.h"
 #include "readHelper.h"
+#include "OutputFile.h"
 #include "LogHelper.h"
 
+void StreamBuffer::setView(const BYTE* data, QWORD size)
+{
+	m_ownedData.reset();
+	m_data = data;
+	m_size = size;
+}
+
+BYTE* StreamBuffer::allocate(QWORD size)
+{
+	m_ownedData.reset(new BYTE[static_cast<size_t>(size)]);
+	m_data = m_ownedData.get();
+	m_size = size;
+	return m_ownedData.get();
+}
+
+void StreamBuffer::reset()
+{
+	m_ownedData.reset();
+	m_data = nullptr;
+	m_size = 0;
+}
+
+const BYTE* StreamBuffer::data() const
+{
+	return m_data;
+}
+
+QWORD StreamBuffer::size() const
+{
+	return m_size;
+}
+
+bool StreamBuffer::isView() const
+{
+	return m_data != nullptr && !m_ownedData;
+}
+
 CfbExtractor::CfbExtractor()
 {
 
@@ -19,38 +57,36 @@ CfbExtractor::~CfbExtractor()
 
 	if (m_miniFatEntries)
 		delete[] m_miniFatEntries;
-
-	if (m_miniStream)
-		delete[] m_miniStream;
-
-	if (m_input)
-		m_input.close();
 }
 
 bool CfbExtractor::initialize(const std::string fullPath)
 {
-	m_input.open(fullPath, std::ios::binary);
-	if (!m_input.is_open())
+	//by default whole file is mapped into memory, so every sector can be accessed without seek and read
+	std::unique_ptr<MappedFile> mappedFile(new MappedFile());
+	if (!mappedFile->open(fullPath))
 	{
 		LogHelper::PrintLog(LogLevel::Error, "Failed to open cfb file");
 		return false;
 	}
+	return initialize(std::move(mappedFile));
+}
 
-	//getFileSize
-	m_input.seekg(0, std::ios::end);
-	DWORD zero = 0;
-	if (m_input.tellg() > static_cast<std::streampos>(zero - 1))
+// input can be any byte source: file read by pread, memory buffer, spooled pipe
+bool CfbExtractor::initialize(std::unique_ptr<ByteSource> input)
+{
+	if (!input)
 	{
-		LogHelper::PrintLog(LogLevel::Error, "File to long. Max file size: 4,294,967,295");
+		LogHelper::PrintLog(LogLevel::Error, "Input byte source is nullptr");
 		return false;
 	}
-	m_fileSize = static_cast<DWORD>(m_input.tellg());
-	m_input.seekg(std::ios::beg);
-	//end of getFileSize
+	m_input = std::move(input);
+	m_sectorCache.init(m_input.get(), m_input->data() ? 0 : Default_Sector_Cache_Size);
 
-	LogHelper::PrintLog(LogLevel::Info, "File Size: ", m_fileSize);
+	m_fileSize = m_input->size();
+	std::string msg = "File Size: " + std::to_string(m_fileSize);
+	LogHelper::PrintLog(LogLevel::Info, msg.data());
 
-	if (!readVariable(m_input, m_cfbHeader))
+	if (!readVariable(m_sectorCache, m_cfbHeader))
 	{
 		LogHelper::PrintLog(LogLevel::Error, "Problem with loading cfbHeader");
 		return false;
@@ -129,13 +165,23 @@ bool CfbExtractor::parseCfbHeader()
 
 	m_miniSectionSize = 1 << m_cfbHeader.miniSecShift;
 	LogHelper::PrintLog(LogLevel::Info, "Sector size = ", m_miniSectionSize);
+	m_sectorLocator.initRegular(m_sectionSize);
 
-	m_sectionCount = m_fileSize / m_sectionSize - 1;
+	QWORD sectionCount = m_fileSize / m_sectionSize - 1;
 	if (m_fileSize % m_sectionSize)
 	{
-		m_sectionCount++;
+		sectionCount++;
+	}
+
+	//sector number is always DWORD, so sectors behind MAXREGSECT can't be addressed
+	if (sectionCount > static_cast<QWORD>(MAXREGSECT) + 1)
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "File is bigger than the maximal addressable size. Rest of file is ignored");
+		sectionCount = static_cast<QWORD>(MAXREGSECT) + 1;
 	}
-	LogHelper::PrintLog(LogLevel::Info, "Sections number = ", m_sectionCount);
+	m_sectionCount = static_cast<DWORD>(sectionCount);
+	std::string msg = "Sections number = " + std::to_string(m_sectionCount);
+	LogHelper::PrintLog(LogLevel::Info, msg.data());
 
 	if (m_cfbHeader.difatArray[0] >= m_sectionCount - 1)
 	{
@@ -152,6 +198,15 @@ bool CfbExtractor::loadFatEntries()
 	bool breakAfterLoop = false;
 
 	const DWORD dwordsInSection = m_sectionSize / sizeof(DWORD);
+
+	//each fat section is a sector of the file, so crafted count can't make the fat array overflow
+	if (m_cfbHeader.fatSecNum > m_sectionCount
+		|| static_cast<QWORD>(m_cfbHeader.fatSecNum) * dwordsInSection > static_cast<QWORD>(MAXREGSECT) + 1)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "Incorrect number of fat sections: ", m_cfbHeader.fatSecNum);
+		return false;
+	}
+
 	DWORD * difatEntries = new DWORD[m_cfbHeader.fatSecNum];
 
 	do {
@@ -175,11 +230,11 @@ bool CfbExtractor::loadFatEntries()
 				{
 					dwordsCountToReadInThisIter = difatsToRead;
 				}
-				DWORD difatSectionOffset = (difatSecId + 1) * m_sectionSize;
-				ASSERT_BREAK_AFTER_LOOP_1(readArray(m_input, difatEntries + MAX_FAT_SECTIONS_COUNT_IN_HEADER + i * maxDifatsInSections, 
+				QWORD difatSectionOffset = static_cast<QWORD>(difatSecId + 1) * m_sectionSize;
+				ASSERT_BREAK_AFTER_LOOP_1(readArray(m_sectorCache, difatEntries + MAX_FAT_SECTIONS_COUNT_IN_HEADER + i * maxDifatsInSections, 
 					dwordsCountToReadInThisIter, difatSectionOffset), breakAfterLoop);
 
-				ASSERT_BREAK_AFTER_LOOP_1(readVariable(m_input, difatSecId, difatSectionOffset + m_sectionSize - sizeof(DWORD)), breakAfterLoop);
+				ASSERT_BREAK_AFTER_LOOP_1(readVariable(m_sectorCache, difatSecId, difatSectionOffset + m_sectionSize - sizeof(DWORD)), breakAfterLoop);
 				difatsToRead -= maxDifatsInSections;
 			}
 		}
@@ -189,10 +244,19 @@ bool CfbExtractor::loadFatEntries()
 		const DWORD maxFatArraySize = m_cfbHeader.fatSecNum * dwordsInSection;
 
 		m_fatEntries = new DWORD[maxFatArraySize];
-		for (DWORD i = 0; i < m_cfbHeader.fatSecNum; i++)
+		m_fatArraySize = maxFatArraySize;
+		for (DWORD i = 0; i < m_cfbHeader.fatSecNum;)
 		{
-			DWORD fatSectionOffset = (difatEntries[i] + 1) * m_sectionSize;
-			ASSERT_BREAK_AFTER_LOOP_1(readArray(m_input, m_fatEntries + i * dwordsInSection, dwordsInSection, fatSectionOffset), breakAfterLoop)
+			//fat sections are usually consecutive, so read the whole run at once
+			DWORD runLength = 1;
+			while (i + runLength < m_cfbHeader.fatSecNum && difatEntries[i + runLength] == difatEntries[i] + runLength)
+			{
+				runLength++;
+			}
+
+			QWORD fatSectionOffset = static_cast<QWORD>(difatEntries[i] + 1) * m_sectionSize;
+			ASSERT_BREAK_AFTER_LOOP_1(readArray(m_sectorCache, m_fatEntries + i * dwordsInSection, runLength * dwordsInSection, fatSectionOffset), breakAfterLoop)
+			i += runLength;
 		}
 	
 		status = true;
@@ -206,14 +270,14 @@ bool CfbExtractor::loadFatEntries()
 	return status;
 }
 
-bool CfbExtractor::loadMiniFatEntries()
+bool CfbExtractor::loadMiniFatEntries() const
 {
 	//minifat section
 	const DWORD miniFatEntriesInSection = m_sectionSize / sizeof(DWORD);
 	m_miniFatArraySize = m_cfbHeader.miniFatSecNum * miniFatEntriesInSection;
 	const DWORD miniFatDataSize = m_cfbHeader.miniFatSecNum * m_sectionSize;
 	m_miniFatEntries = new DWORD[m_miniFatArraySize];
-	ASSERT_BOOL(readChunkOfDataFromCfb(m_input, m_miniFatEntries, m_cfbHeader.firstMiniSecId, miniFatDataSize, m_sectionSize, m_fatEntries, m_sectionCount));
+	ASSERT_BOOL(readChunkOfDataFromCfb(m_sectorCache, m_miniFatEntries, m_cfbHeader.firstMiniSecId, miniFatDataSize, m_sectorLocator, m_fatEntries, getFatEntriesCount()));
 	return true;
 }
 
@@ -225,16 +289,16 @@ bool CfbExtractor::loadDirEntries()
 	if (m_cfbHeader.majorVer == 3)
 	{
 		//dirSecNum is not used in version 3 so we need to count this number
-		while (dirSecId != ENDOFCHAIN)
+		ChainWalker walker(m_fatEntries, getFatEntriesCount(), dirSecId);
+		while (walker.next(dirSecId))
 		{
-			if (dirSecId >= m_sectionCount)
-			{
-				LogHelper::PrintLog(LogLevel::Error, "\"dirSecId\" index out of bound: ", dirSecId);
-				return false;
-			}
-
 			dirSecNum++;
-			dirSecId = m_fatEntries[dirSecId];
+		}
+
+		if (walker.error() != ChainError::None)
+		{
+			walker.logError("loadDirEntries");
+			return false;
 		}
 	}
 
@@ -242,23 +306,67 @@ bool CfbExtractor::loadDirEntries()
 	m_dirEntriesCount = dirSecNum * dirEntriesInSection;
 	const DWORD dirDataSize = dirSecNum * m_sectionSize;
 	m_dirEntries = new DirectoryEntry[m_dirEntriesCount];
-	ASSERT_BOOL(readChunkOfDataFromCfb(m_input, m_dirEntries, m_cfbHeader.firstDirSecId, dirDataSize, m_sectionSize, m_fatEntries, m_sectionCount));
+	ASSERT_BOOL(readChunkOfDataFromCfb(m_sectorCache, m_dirEntries, m_cfbHeader.firstDirSecId, dirDataSize, m_sectorLocator, m_fatEntries, getFatEntriesCount()));
 	m_rootDirEntry = m_dirEntries[0];
 	return true;
 }
 
-bool CfbExtractor::loadMiniStreamEntries()
+/*	Mini stream is needed only for streams smaller than minStreamSize. Many callers read only big streams,
+	so miniFat and mini stream are loaded on the first access to the small stream. Streams can be read
+	from many threads, so only one of them loads it and others wait.
+*/
+bool CfbExtractor::loadMiniStream() const
+{
+	std::call_once(m_miniStreamOnce, [this]()
+	{
+		m_miniStreamStatus = loadMiniFatEntries() && loadMiniStreamEntries();
+		if (m_miniStreamStatus && !validateMiniChains())
+		{
+			LogHelper::PrintLog(LogLevel::Warning, "Some mini sector chains are broken. Results can be incomplete");
+		}
+	});
+	return m_miniStreamStatus;
+}
+
+/*	Mini stream isn't copied into memory. We remember only regular sectors of its chain, 
+	then every mini sector can be found in the mapped file.
+*/
+bool CfbExtractor::loadMiniStreamEntries() const
 {
 	//mini stream
-	DWORD miniStreamSize = static_cast<DWORD>(m_rootDirEntry.streamSize);
-	m_miniStream = new BYTE[miniStreamSize];
-	ASSERT_BOOL(readChunkOfDataFromCfb(m_input, m_miniStream, m_rootDirEntry.startSecLocation, miniStreamSize, m_sectionSize, m_fatEntries, m_sectionCount));
+	QWORD miniStreamSize = getStreamSize(m_rootDirEntry);
+	if (miniStreamSize > m_fileSize)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "Mini stream size is bigger than file size");
+		return false;
+	}
+
+	m_miniStreamSectors.clear();
+	ChainWalker walker(m_fatEntries, getFatEntriesCount(), m_rootDirEntry.startSecLocation);
+	for (QWORD bytesToEnd = miniStreamSize; bytesToEnd > 0;)
+	{
+		DWORD sector = 0;
+		if (!walker.next(sector))
+		{
+			if (walker.error() == ChainError::None)
+			{
+				LogHelper::PrintLog(LogLevel::Error, "loadMiniStreamEntries - chain is shorter than stream");
+			}
+			walker.logError("loadMiniStreamEntries");
+			return false;
+		}
+
+		m_miniStreamSectors.push_back(sector);
+		bytesToEnd -= (std::min)(bytesToEnd, static_cast<QWORD>(m_sectionSize));
+	}
+
+	m_miniSectorLocator.initMini(m_miniSectionSize, m_sectionSize, m_miniStreamSectors.data(), static_cast<DWORD>(m_miniStreamSectors.size()));
 	return true;
 }
 
 bool CfbExtractor::initRedableStreamNamesFromRawNames()
 {
-	std::string name;
+	std::vector<std::string> entryNames(m_dirEntriesCount);
 	for (DWORD i = 0; i < m_dirEntriesCount; i++)
 	{
 		const DirectoryEntry& streamEntry = m_dirEntries[i];
@@ -273,47 +381,326 @@ bool CfbExtractor::initRedableStreamNamesFromRawNames()
 				continue;
 			}
 		}
-		ASSERT_BOOL(convertStreamNameToReadableString(streamEntry.dirEntryName, streamEntry.dirEntryNameLength, name));
-		m_mapStreamNameToSectionId[name] = i;
+		ASSERT_BOOL(convertStreamNameToReadableString(streamEntry.dirEntryName, streamEntry.dirEntryNameLength, entryNames[i]));
 	}
+
+	ASSERT_BOOL(m_directoryIndex.build(m_dirEntries, m_dirEntriesCount, entryNames));
 	return true;
 }
 
-bool CfbExtractor::readAndAllocateStream(std::string streamName, BYTE** stream, DWORD& streamSize)
+/*	Walks every chain in the file once and checks if chains have no loops, don't point outside the file
+	and don't share sectors. Sectors of the FAT itself are claimed first, so a stream which points
+	into the FAT is reported as cross-linked. Problems are only reported, reading still protects itself.
+*/
+bool CfbExtractor::validateChains()
 {
-	if (m_mapStreamNameToSectionId.count(streamName) <= 0)
+	bool status = true;
+
+	//sectors which aren't covered by the fat can't belong to any chain (walker reports them as out of range)
+	const DWORD fatEntriesCount = getFatEntriesCount();
+	if (fatEntriesCount < m_sectionCount)
 	{
-		LogHelper::PrintLog(LogLevel::Warning, "The table doesn't belong to msi or is empty");
-		return false;
+		std::string msg = "Fat covers only " + std::to_string(fatEntriesCount) + " of " + std::to_string(m_sectionCount) + " sectors";
+		LogHelper::PrintLog(LogLevel::Warning, msg.data());
 	}
 
-	const DirectoryEntry& streamEntry = m_dirEntries[m_mapStreamNameToSectionId[streamName]];
-	if (streamEntry.objectType == DirEntryType::Stream)
+	SectorBitmap claimedSectors;
+	claimedSectors.init(fatEntriesCount);
+	for (DWORD i = 0; i < fatEntriesCount; i++)
 	{
-		DWORD streamSecId = streamEntry.startSecLocation;
-		streamSize = static_cast<DWORD>(streamEntry.streamSize);
-		*stream = new BYTE[streamSize];
+		if (m_fatEntries[i] == FATSECT || m_fatEntries[i] == DIFSECT)
+		{
+			claimedSectors.testAndSet(i);
+		}
+	}
+
+	//system chains
+	status &= validateChain("Directory", m_fatEntries, getFatEntriesCount(), m_cfbHeader.firstDirSecId, claimedSectors);
+	if (m_cfbHeader.miniFatSecNum > 0)
+	{
+		status &= validateChain("MiniFat", m_fatEntries, getFatEntriesCount(), m_cfbHeader.firstMiniSecId, claimedSectors);
+	}
 
-		if (streamSize <= m_cfbHeader.minStreamSize)
+	for (DWORD i = 0; i < m_dirEntriesCount; i++)
+	{
+		const DirectoryEntry& entry = m_dirEntries[i];
+		const QWORD streamSize = getStreamSize(entry);
+		//small streams are checked with the mini stream
+		if ((entry.objectType != DirEntryType::Stream && entry.objectType != DirEntryType::RootStorage) || streamSize == 0
+			|| (entry.objectType == DirEntryType::Stream && streamSize < m_cfbHeader.minStreamSize))
 		{
-			//data is stored in miniStream
-			ASSERT_BOOL(readChunkOfDataFromCfb(m_miniStream, *stream, streamSecId, streamSize, m_miniSectionSize, m_miniFatEntries, m_miniFatArraySize, true));
+			continue;
 		}
-		else
+
+		const std::string chainName = "Dir entry " + std::to_string(i);
+		status &= validateChain(chainName.data(), m_fatEntries, getFatEntriesCount(), entry.startSecLocation, claimedSectors);
+	}
+
+	return status;
+}
+
+// fat entries which can be used as sector indices. Fat can be shorter than the file (truncated or crafted fat)
+// and longer (unused entries in the last fat section)
+DWORD CfbExtractor::getFatEntriesCount() const
+{
+	return (std::min)(m_sectionCount, m_fatArraySize);
+}
+
+bool CfbExtractor::validateMiniChains() const
+{
+	bool status = true;
+
+	SectorBitmap claimedMiniSectors;
+	claimedMiniSectors.init(m_miniFatArraySize);
+	for (DWORD i = 0; i < m_dirEntriesCount; i++)
+	{
+		const DirectoryEntry& entry = m_dirEntries[i];
+		const QWORD streamSize = getStreamSize(entry);
+		if (entry.objectType != DirEntryType::Stream || streamSize == 0 || streamSize >= m_cfbHeader.minStreamSize)
 		{
-			ASSERT_BOOL(readChunkOfDataFromCfb(m_input, *stream, streamSecId, streamSize, m_sectionSize, m_fatEntries, m_sectionCount, false));
+			continue;
 		}
+
+		const std::string chainName = "Dir entry " + std::to_string(i);
+		status &= validateChain(chainName.data(), m_miniFatEntries, m_miniFatArraySize, entry.startSecLocation, claimedMiniSectors);
+	}
+
+	return status;
+}
+
+bool CfbExtractor::validateChain(const char* chainName, const DWORD* sectionInfoArray, DWORD sectionArraySize, DWORD firstSector, SectorBitmap& claimedSectors) const
+{
+	ChainWalker walker(sectionInfoArray, sectionArraySize, firstSector, &claimedSectors);
+	DWORD sector = 0;
+	while (walker.next(sector))
+	{
+	}
+
+	if (walker.error() != ChainError::None)
+	{
+		walker.logError(chainName);
+		return false;
+	}
+	return true;
+}
+
+bool CfbExtractor::getStreamEntry(const std::string& streamPath, const DirectoryEntry*& streamEntry, DWORD& entryId) const
+{
+	const DirectoryNode* node = m_directoryIndex.find(streamPath);
+	if (!node)
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "The table doesn't belong to msi or is empty");
+		return false;
+	}
+
+	entryId = node->entryId;
+	streamEntry = &m_dirEntries[entryId];
+	return true;
+}
+
+/*	In version 3 the most significant 32 bits of the stream size SHOULD be zero, but older implementations
+	can leave there a garbage. Therefore for version 3 we take only lower 32 bits.
+*/
+QWORD CfbExtractor::getStreamSize(const DirectoryEntry& streamEntry) const
+{
+	if (m_cfbHeader.majorVer == 3)
+	{
+		return streamEntry.streamSize & 0xFFFFFFFF;
+	}
+	return streamEntry.streamSize;
+}
+
+bool CfbExtractor::readStream(const std::string& streamPath, StreamBuffer& stream) const
+{
+	const DirectoryEntry* streamEntry = nullptr;
+	DWORD entryId = 0;
+	ASSERT_BOOL(getStreamEntry(streamPath, streamEntry, entryId));
+
+	if (streamEntry->objectType == DirEntryType::Stream)
+	{
+		DWORD streamSecId = streamEntry->startSecLocation;
+		QWORD streamSize = getStreamSize(*streamEntry);
+
+		//data smaller than minStreamSize is stored in miniStream
+		ASSERT_BOOL(readSectorChain(streamSecId, streamSize, streamSize < m_cfbHeader.minStreamSize, stream));
+	}
+	else
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "The directory is storage, not a stream. Dir id: ", entryId);
+	}
+	return true;
+}
+
+/*	Big streams (eg. cabinets with media) can have gigabytes, so we shouldn't allocate them whole.
+	Returned reader walks the sector chain lazily and reads the stream in chunks.
+	Each reader has its own position, so many readers can be used at once from different threads.
+*/
+bool CfbExtractor::openStream(const std::string& streamPath, StreamReader& reader) const
+{
+	const DirectoryEntry* streamEntry = nullptr;
+	DWORD entryId = 0;
+	ASSERT_BOOL(getStreamEntry(streamPath, streamEntry, entryId));
+
+	if (streamEntry->objectType != DirEntryType::Stream)
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "The directory is storage, not a stream. Dir id: ", entryId);
+		return false;
+	}
+
+	QWORD streamSize = getStreamSize(*streamEntry);
+	if (streamSize > m_fileSize)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "Stream size is bigger than file size");
+		return false;
+	}
+
+	//data smaller than minStreamSize is stored in miniStream
+	if (streamSize < m_cfbHeader.minStreamSize)
+	{
+		ASSERT_BOOL(loadMiniStream());
+		reader.init(&m_sectorCache, m_miniSectorLocator, m_miniFatEntries, m_miniFatArraySize, 
+			streamEntry->startSecLocation, streamSize);
 	}
 	else
 	{
-		LogHelper::PrintLog(LogLevel::Warning, "The directory is storage, not a stream. Dir id: ", m_mapStreamNameToSectionId[streamName]);
+		reader.init(&m_sectorCache, m_sectorLocator, m_fatEntries, getFatEntriesCount(), 
+			streamEntry->startSecLocation, streamSize);
+	}
+	return true;
+}
+
+/*	Sectors of the stream are very often stored one after the other. In this case we don't copy anything
+	and return only a view into the mapped file (or memory buffer). Fragmented chains are copied extent by extent.
+*/
+bool CfbExtractor::readSectorChain(DWORD sectorIndex, QWORD streamSize, bool fromMiniStream, StreamBuffer& stream) const
+{
+	stream.reset();
+	if (streamSize == 0)
+	{
+		return true;
+	}
+
+	//the stream can't be bigger than the whole file. It protects against huge allocations
+	if (streamSize > m_fileSize)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "Stream size is bigger than file size");
+		return false;
+	}
+
+	std::vector<FileExtent> extents;
+	ASSERT_BOOL(getFileExtents(sectorIndex, streamSize, fromMiniStream, extents));
+
+	//view is possible only if the source keeps the whole file in memory
+	const BYTE* input = m_sectorCache.data();
+	const QWORD inputSize = m_sectorCache.size();
+	if (input && extents.size() == 1)
+	{
+		const QWORD streamOffset = extents[0].offset;
+		if (streamOffset <= inputSize && inputSize - streamOffset >= streamSize)
+		{
+			stream.setView(input + streamOffset, streamSize);
+			m_sectorCache.noteDirectAccess(streamSize);
+			return true;
+		}
+	}
+
+	if (streamSize > static_cast<QWORD>(SIZE_MAX))
+	{
+		LogHelper::PrintLog(LogLevel::Error, "Fragmented stream is too big to be loaded into memory. Use openStream");
+		return false;
+	}
+
+	ASSERT_BOOL(readFileExtents(m_sectorCache, stream.allocate(streamSize), extents));
+	return true;
+}
+
+// extents of the stream in the input file. Mini stream sectors are translated to their place in the file
+bool CfbExtractor::getFileExtents(DWORD sectorIndex, QWORD streamSize, bool fromMiniStream, std::vector<FileExtent>& extents) const
+{
+	if (fromMiniStream)
+	{
+		ASSERT_BOOL(loadMiniStream());
+		return buildFileExtents(sectorIndex, streamSize, m_miniSectorLocator, m_miniFatEntries, m_miniFatArraySize, extents);
+	}
+	return buildFileExtents(sectorIndex, streamSize, m_sectorLocator, m_fatEntries, getFatEntriesCount(), extents);
+}
+
+// true if streams can be written to the file without a buffer: input is in memory or it can be copied by the kernel
+bool CfbExtractor::canCopyStreamToFile() const
+{
+	return m_sectorCache.data() || m_sectorCache.supportsFileCopy();
+}
+
+/*	Stream is written extent by extent. Mapped (or in memory) input is written directly from memory,
+	file input is copied by the kernel (copy_file_range or sendfile). Nothing is buffered in user space.
+	It can be used only if canCopyStreamToFile returns true.
+*/
+bool CfbExtractor::copyStreamToFile(const std::string& streamPath, OutputFile& output) const
+{
+	const DirectoryEntry* streamEntry = nullptr;
+	DWORD entryId = 0;
+	ASSERT_BOOL(getStreamEntry(streamPath, streamEntry, entryId));
+
+	if (streamEntry->objectType != DirEntryType::Stream)
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "The directory is storage, not a stream. Dir id: ", entryId);
+		return false;
+	}
+
+	QWORD streamSize = getStreamSize(*streamEntry);
+	if (streamSize > m_fileSize)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "Stream size is bigger than file size");
+		return false;
+	}
+
+	//data smaller than minStreamSize is stored in miniStream
+	std::vector<FileExtent> extents;
+	ASSERT_BOOL(getFileExtents(streamEntry->startSecLocation, streamSize, streamSize < m_cfbHeader.minStreamSize, extents));
+
+	const BYTE* input = m_sectorCache.data();
+	const QWORD inputSize = m_sectorCache.size();
+	for (const FileExtent& extent : extents)
+	{
+		if (extent.offset > inputSize || inputSize - extent.offset < extent.size)
+		{
+			std::string msg = "copyStreamToFile - read out of bound. Offset: " + std::to_string(extent.offset);
+			LogHelper::PrintLog(LogLevel::Error, msg.data());
+			return false;
+		}
+
+		if (input)
+		{
+			ASSERT_BOOL(output.write(input + extent.offset, extent.size));
+			m_sectorCache.noteDirectAccess(extent.size);
+		}
+		else
+		{
+			ASSERT_BOOL(m_sectorCache.copyToFile(extent.offset, extent.size, output));
+		}
 	}
 	return true;
 }
 
-const std::map<std::string, DWORD>& CfbExtractor::getMapStreamNameToSectionId() const
+// 0 disables the cache. It should be called after initialize
+void CfbExtractor::setSectorCacheSize(QWORD cacheSize)
+{
+	m_sectorCache.setCapacity(cacheSize);
+}
+
+const DirectoryIndex& CfbExtractor::getDirectoryIndex() const
+{
+	return m_directoryIndex;
+}
+
+SectorCacheStats CfbExtractor::getSectorCacheStats() const
+{
+	return m_sectorCache.getStats();
+}
+
+QWORD CfbExtractor::getFileSize() const
 {
-	return m_mapStreamNameToSectionId;
+	return m_fileSize;
 }
 
 /*	The names of stream which contain a msi tables are very strange. These names are encoded. I spent a lot of ttime 
@@ -0,0 +1,120 @@
+#include <string>
+
+#include "ChainWalker.h"
+#include "CfbExtractor.h"
+#include "LogHelper.h"
+
+void SectorBitmap::init(DWORD sectorCount)
+{
+	m_pages.clear();
+	m_pages.resize(sectorCount / Bits_In_Page + 1);
+}
+
+// returns previous value of the bit
+bool SectorBitmap::testAndSet(DWORD sector)
+{
+	std::unique_ptr<QWORD[]>& page = m_pages[sector / Bits_In_Page];
+	if (!page)
+	{
+		page.reset(new QWORD[Words_In_Page]());
+	}
+
+	const DWORD bitInPage = sector % Bits_In_Page;
+	QWORD& word = page[bitInPage / 64];
+	const QWORD mask = 1ULL << (bitInPage % 64);
+
+	const bool wasSet = (word & mask) != 0;
+	word |= mask;
+	return wasSet;
+}
+
+ChainWalker::ChainWalker()
+{
+
+}
+
+ChainWalker::ChainWalker(const DWORD* sectionInfoArray, DWORD sectionArraySize, DWORD firstSector, SectorBitmap* claimedSectors)
+{
+	init(sectionInfoArray, sectionArraySize, firstSector, claimedSectors);
+}
+
+void ChainWalker::init(const DWORD* sectionInfoArray, DWORD sectionArraySize, DWORD firstSector, SectorBitmap* claimedSectors)
+{
+	m_sectionInfoArray = sectionInfoArray;
+	m_sectionArraySize = sectionArraySize;
+	m_currentSector = firstSector;
+	m_claimedSectors = claimedSectors;
+	m_visited.init(sectionArraySize);
+	m_error = ChainError::None;
+	m_errorSector = 0;
+}
+
+/*	Returns current sector and moves to the next one. False means the end of chain (ENDOFCHAIN)
+	or an error. In the second case error() says what is wrong.
+*/
+bool ChainWalker::next(DWORD& sector)
+{
+	if (m_error != ChainError::None || m_currentSector == ENDOFCHAIN)
+	{
+		return false;
+	}
+
+	if (m_currentSector >= m_sectionArraySize)
+	{
+		m_error = ChainError::OutOfRange;
+	}
+	else if (m_visited.testAndSet(m_currentSector))
+	{
+		m_error = ChainError::Cycle;
+	}
+	else if (m_claimedSectors && m_claimedSectors->testAndSet(m_currentSector))
+	{
+		m_error = ChainError::CrossLinked;
+	}
+
+	if (m_error != ChainError::None)
+	{
+		m_errorSector = m_currentSector;
+		return false;
+	}
+
+	sector = m_currentSector;
+	m_currentSector = m_sectionInfoArray[m_currentSector];
+	return true;
+}
+
+void ChainWalker::logError(const char* chainName) const
+{
+	std::string msg = std::string(chainName) + " - ";
+	switch (m_error)
+	{
+	case ChainError::OutOfRange:
+		msg += "\"sectorIndex\" index out of bound: ";
+		break;
+	case ChainError::Cycle:
+		msg += "cycle in the sector chain. Sector: ";
+		break;
+	case ChainError::CrossLinked:
+		msg += "sector belongs to more than one chain. Sector: ";
+		break;
+	default:
+		return;
+	}
+	msg += std::to_string(m_errorSector);
+	LogHelper::PrintLog(LogLevel::Error, msg.data());
+}
+
+DWORD ChainWalker::currentSector() const
+{
+	return m_currentSector;
+}
+
+ChainError ChainWalker::error() const
+{
+	return m_error;
+}
+
+DWORD ChainWalker::errorSector() const
+{
+	return m_errorSector;
+}
@@ -0,0 +1,157 @@
+#include <algorithm>
+
+#include "DirectoryIndex.h"
+#include "CfbExtractor.h"
+#include "ChainWalker.h"
+#include "LogHelper.h"
+#include "hashHelper.h"
+
+/*	Each entry can be reached only once from the root, so the bitmap of visited entries protects us
+	against loops in the sibling trees (crafted files) and entries shared by two storages.
+	Broken entry (out of bound or reached again) is skipped with its subtree, the rest of the file is still indexed.
+*/
+bool DirectoryIndex::build(const DirectoryEntry* dirEntries, DWORD dirEntriesCount, const std::vector<std::string>& entryNames)
+{
+	clear();
+	if (dirEntriesCount == 0 || entryNames.size() < dirEntriesCount)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "DirectoryIndex - no directory entries");
+		return false;
+	}
+
+	SectorBitmap visitedEntries;
+	visitedEntries.init(dirEntriesCount);
+	visitedEntries.testAndSet(0);
+
+	//storages which children weren't indexed yet. Root storage is always the first entry
+	std::vector<DWORD> storagesToVisit = { 0 };
+	std::vector<DWORD> siblingsToVisit;
+	std::vector<std::string> parentPaths = { "" };
+
+	for (size_t storageIndex = 0; storageIndex < storagesToVisit.size(); storageIndex++)
+	{
+		const DWORD storageId = storagesToVisit[storageIndex];
+		const std::string parentPath = parentPaths[storageIndex];
+
+		siblingsToVisit.clear();
+		if (dirEntries[storageId].childId != NOSTREAM)
+		{
+			siblingsToVisit.push_back(dirEntries[storageId].childId);
+		}
+
+		while (!siblingsToVisit.empty())
+		{
+			const DWORD entryId = siblingsToVisit.back();
+			siblingsToVisit.pop_back();
+
+			if (entryId >= dirEntriesCount)
+			{
+				LogHelper::PrintLog(LogLevel::Warning, "DirectoryIndex - entry index out of bound, subtree is skipped: ", entryId);
+				continue;
+			}
+
+			if (visitedEntries.testAndSet(entryId))
+			{
+				LogHelper::PrintLog(LogLevel::Warning, "DirectoryIndex - entry is reachable more than once, subtree is skipped: ", entryId);
+				continue;
+			}
+
+			const DirectoryEntry& entry = dirEntries[entryId];
+			if (entry.leftSiblingId != NOSTREAM)
+			{
+				siblingsToVisit.push_back(entry.leftSiblingId);
+			}
+			if (entry.rightSiblingId != NOSTREAM)
+			{
+				siblingsToVisit.push_back(entry.rightSiblingId);
+			}
+
+			DirectoryNode node;
+			node.name = entryNames[entryId];
+			node.path = parentPath.empty() ? node.name : parentPath + Path_Separator + node.name;
+			node.entryId = entryId;
+			node.parentEntryId = storageId;
+			node.objectType = entry.objectType;
+
+			if (entry.objectType == DirEntryType::Storage)
+			{
+				storagesToVisit.push_back(entryId);
+				parentPaths.push_back(node.path);
+			}
+			m_nodes.push_back(node);
+		}
+	}
+
+	std::stable_sort(m_nodes.begin(), m_nodes.end(), [](const DirectoryNode& a, const DirectoryNode& b) { return a.path < b.path; });
+	buildHashTable();
+	return true;
+}
+
+void DirectoryIndex::clear()
+{
+	m_nodes.clear();
+	m_slots.clear();
+	m_slotMask = 0;
+}
+
+// returns nullptr if there is no entry with this path
+const DirectoryNode* DirectoryIndex::find(const std::string& path) const
+{
+	if (m_slots.empty())
+	{
+		return nullptr;
+	}
+
+	for (QWORD slot = hashString(path) & m_slotMask; m_slots[slot] != Empty_Slot; slot = (slot + 1) & m_slotMask)
+	{
+		const DirectoryNode& node = m_nodes[m_slots[slot]];
+		if (node.path == path)
+		{
+			return &node;
+		}
+	}
+	return nullptr;
+}
+
+const std::vector<DirectoryNode>& DirectoryIndex::getNodes() const
+{
+	return m_nodes;
+}
+
+/*	Linear probing with load factor at most 0.5. Table is built once and never modified,
+	so we don't need deletion markers.
+*/
+void DirectoryIndex::buildHashTable()
+{
+	QWORD slotCount = 16;
+	while (slotCount < static_cast<QWORD>(m_nodes.size()) * 2)
+	{
+		slotCount *= 2;
+	}
+	m_slots.assign(static_cast<size_t>(slotCount), Empty_Slot);
+	m_slotMask = slotCount - 1;
+
+	for (DWORD i = 0; i < m_nodes.size(); i++)
+	{
+		QWORD slot = hashString(m_nodes[i].path) & m_slotMask;
+		bool duplicate = false;
+		while (m_slots[slot] != Empty_Slot)
+		{
+			if (m_nodes[m_slots[slot]].path == m_nodes[i].path)
+			{
+				duplicate = true;
+				break;
+			}
+			slot = (slot + 1) & m_slotMask;
+		}
+
+		//in one storage names should be unique. If they aren't, the first one wins
+		if (duplicate)
+		{
+			std::string msg = "DirectoryIndex - duplicated path: " + m_nodes[i].path;
+			LogHelper::PrintLog(LogLevel::Warning, msg.data());
+			continue;
+		}
+		m_slots[slot] = i;
+	}
+}
@@ -0,0 +1,198 @@
+#include <cctype>
+
+#include "FormattedStringResolver.h"
+#include "LogHelper.h"
+
+FormattedStringResolver::FormattedStringResolver(const std::map<std::string_view, std::string_view>& properties)
+	: m_properties(properties)
+{
+
+}
+
+void FormattedStringResolver::resolve(std::string_view input, std::string& output)
+{
+	output.clear();
+	output.reserve(input.size());
+	resolveInto(input, output, 0);
+}
+
+// must be called after any property is changed, because memoized values can depend on it
+void FormattedStringResolver::invalidate()
+{
+	m_resolved.clear();
+}
+
+/*	Text between references is copied at once. Brackets are paired once at the beginning, so finding the end
+	of a reference (or learning that it is not closed) costs O(1). Only the text inside a reference is scanned
+	again, so input is processed in linear time (multiplied by nesting level).
+	Returns false if some reference was left unresolved only because of the depth limit.
+*/
+bool FormattedStringResolver::resolveInto(std::string_view input, std::string& output, DWORD depth)
+{
+	if (input.find('[') == std::string_view::npos)
+	{
+		output.append(input);
+		return true;
+	}
+
+	std::vector<size_t> closingBrackets;
+	pairBrackets(input, closingBrackets);
+
+	bool complete = true;
+	size_t position = 0;
+	while (position < input.size())
+	{
+		const size_t openBracket = input.find('[', position);
+		if (openBracket == std::string_view::npos)
+		{
+			output.append(input.substr(position));
+			break;
+		}
+		output.append(input.substr(position, openBracket - position));
+
+		//escaped char: "[\x]"
+		if (openBracket + 3 < input.size() && input[openBracket + 1] == '\\' && input[openBracket + 3] == ']')
+		{
+			output += input[openBracket + 2];
+			position = openBracket + 4;
+			continue;
+		}
+
+		const size_t closeBracket = closingBrackets[openBracket];
+		if (closeBracket == std::string_view::npos)
+		{
+			//not closed. It isn't a reference, but references after it can be valid (eg. "[[A]")
+			output += '[';
+			position = openBracket + 1;
+			continue;
+		}
+
+		complete &= resolveReference(input.substr(openBracket, closeBracket - openBracket + 1), output, depth);
+		position = closeBracket + 1;
+	}
+	return complete;
+}
+
+// reference is "[...]" with brackets. If it can't be resolved, it is copied unchanged. Returns false like resolveInto
+bool FormattedStringResolver::resolveReference(std::string_view reference, std::string& output, DWORD depth)
+{
+	const std::string_view content = reference.substr(1, reference.size() - 2);
+	if (depth >= Max_Depth)
+	{
+		output.append(reference);
+		return false;
+	}
+
+	bool complete = true;
+	std::string indirectName;
+	std::string_view name = content;
+	if (content.find('[') != std::string_view::npos)
+	{
+		//indirection: "[[Name]]". Name of the property is a value of the inner reference
+		complete = resolveInto(content, indirectName, depth + 1);
+		name = indirectName;
+	}
+
+	const bool found = isPropertyName(name) && resolveProperty(name, depth + 1, output, complete);
+	if (found)
+	{
+		return complete;
+	}
+
+	if (indirectName.empty())
+	{
+		output.append(reference);
+	}
+	else
+	{
+		output += '[';
+		output.append(indirectName);
+		output += ']';
+	}
+	return complete;
+}
+
+/*	Appends the resolved value. Returns false if property doesn't exist or refers to itself.
+	Value cut short by the depth limit is memoized with its depth. It is reused only as deep or deeper (there it
+	can't be resolved better), from a shallower place it is resolved again. So each property is resolved at most
+	Max_Depth times, even if the limit is hit in many branches.
+*/
+bool FormattedStringResolver::resolveProperty(std::string_view name, DWORD depth, std::string& output, bool& complete)
+{
+	auto property = m_properties.find(name);
+	if (property == m_properties.end())
+	{
+		return false;
+	}
+
+	auto resolved = m_resolved.find(property->first);
+	if (resolved != m_resolved.end())
+	{
+		const ResolvedProperty& memoized = resolved->second;
+		if (memoized.state == ResolveState::InProgress)
+		{
+			std::string msg = "Property refers to itself: " + std::string(name);
+			LogHelper::PrintLog(LogLevel::Warning, msg.data());
+			return false;
+		}
+
+		if (memoized.complete || depth >= memoized.depth)
+		{
+			output.append(memoized.value);
+			complete &= memoized.complete;
+			return true;
+		}
+	}
+
+	//unordered_map doesn't move its elements, so the reference is valid during nested resolving
+	ResolvedProperty& entry = m_resolved[property->first];
+	entry.state = ResolveState::InProgress;
+
+	std::string value;
+	entry.complete = resolveInto(property->second, value, depth);
+	entry.value = std::move(value);
+	entry.depth = depth;
+	entry.state = ResolveState::Done;
+
+	output.append(entry.value);
+	complete &= entry.complete;
+	return true;
+}
+
+// for each '[' position of its matching ']' (npos if it isn't closed), found in one pass with the stack
+void FormattedStringResolver::pairBrackets(std::string_view input, std::vector<size_t>& closingBrackets)
+{
+	closingBrackets.assign(input.size(), std::string_view::npos);
+
+	std::vector<size_t> openBrackets;
+	for (size_t i = 0; i < input.size(); i++)
+	{
+		if (input[i] == '[')
+		{
+			openBrackets.push_back(i);
+		}
+		else if (input[i] == ']' && !openBrackets.empty())
+		{
+			closingBrackets[openBrackets.back()] = i;
+			openBrackets.pop_back();
+		}
+	}
+}
+
+// the same names which were replaced before: letters, digits and '_'
+bool FormattedStringResolver::isPropertyName(std::string_view name)
+{
+	if (name.empty())
+	{
+		return false;
+	}
+
+	for (char c : name)
+	{
+		if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+		{
+			return false;
+		}
+	}
+	return true;
+}
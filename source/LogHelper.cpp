@@ -6,6 +6,7 @@
 
 std::ofstream LogHelper::logFile;
 LogOutput LogHelper::outputType = LogOutput::Undefined;
+std::mutex LogHelper::logMutex;
 
 bool LogHelper::init(const char* filePath)
 {
@@ -25,14 +26,22 @@ void LogHelper::init()
 	outputType = LogOutput::Std;
 }
 
+void LogHelper::initStdErr()
+{
+	outputType = LogOutput::StdErr;
+}
+
 void LogHelper::deinit()
 {
+	std::lock_guard<std::mutex> lock(logMutex);
 	if (logFile)
 		logFile.close();
 }
 
+// logs can be printed from many threads, so whole line is printed under the lock
 void LogHelper::internalLog(const char* logLevelStr, const char* msg)
 {
+	std::lock_guard<std::mutex> lock(logMutex);
 	if (outputType == LogOutput::File)
 	{
 		logFile << logLevelStr << msg << std::endl;
@@ -41,6 +50,10 @@ void LogHelper::internalLog(const char* logLevelStr, const char* msg)
 	{
 		std::cout<< logLevelStr << msg << std::endl;
 	}
+	else if (outputType == LogOutput::StdErr)
+	{
+		std::cerr << logLevelStr << msg << std::endl;
+	}
 }
 
 void LogHelper::PrintLog(LogLevel lvl, const char* msg)
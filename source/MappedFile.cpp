@@ -0,0 +1,171 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+
+#include "MappedFile.h"
+#include "LogHelper.h"
+
+MappedFile::MappedFile()
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	HANDLE fileHandle = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "CreateFile failed. Error: ", static_cast<int>(::GetLastError()));
+		return false;
+	}
+	m_fileHandle = fileHandle;
+
+	LARGE_INTEGER fileSize = { 0 };
+	if (!::GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "Can't map empty file or get its size");
+		close();
+		return false;
+	}
+
+	if (static_cast<QWORD>(fileSize.QuadPart) > static_cast<QWORD>(SIZE_MAX))
+	{
+		LogHelper::PrintLog(LogLevel::Error, "File is too big to be mapped on this platform");
+		close();
+		return false;
+	}
+
+	HANDLE mappingHandle = ::CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "CreateFileMapping failed. Error: ", static_cast<int>(::GetLastError()));
+		close();
+		return false;
+	}
+	m_mappingHandle = mappingHandle;
+
+	void* view = ::MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "MapViewOfFile failed. Error: ", static_cast<int>(::GetLastError()));
+		close();
+		return false;
+	}
+
+	m_data = static_cast<const BYTE*>(view);
+	m_size = static_cast<QWORD>(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+		::UnmapViewOfFile(m_data);
+
+	if (m_mappingHandle)
+		::CloseHandle(m_mappingHandle);
+
+	if (m_fileHandle)
+		::CloseHandle(m_fileHandle);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mappingHandle = nullptr;
+	m_fileHandle = nullptr;
+}
+#else
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	m_fileDescriptor = ::open(path.c_str(), O_RDONLY);
+	if (m_fileDescriptor < 0)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "open failed. Errno: ", errno);
+		return false;
+	}
+
+	struct stat fileStat = { 0 };
+	if (::fstat(m_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "Can't map empty file or get its size");
+		close();
+		return false;
+	}
+
+	if (static_cast<QWORD>(fileStat.st_size) > static_cast<QWORD>(SIZE_MAX))
+	{
+		LogHelper::PrintLog(LogLevel::Error, "File is too big to be mapped on this platform");
+		close();
+		return false;
+	}
+
+	void* view = ::mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+	if (view == MAP_FAILED)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "mmap failed. Errno: ", errno);
+		close();
+		return false;
+	}
+
+	m_data = static_cast<const BYTE*>(view);
+	m_size = static_cast<QWORD>(fileStat.st_size);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+		::munmap(const_cast<BYTE*>(m_data), static_cast<size_t>(m_size));
+
+	if (m_fileDescriptor >= 0)
+		::close(m_fileDescriptor);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_fileDescriptor = -1;
+}
+#endif
+
+bool MappedFile::isOpen() const
+{
+	return m_data != nullptr;
+}
+
+const BYTE* MappedFile::data() const
+{
+	return m_data;
+}
+
+QWORD MappedFile::size() const
+{
+	return m_size;
+}
+
+bool MappedFile::read(QWORD offset, void* buffer, QWORD size) const
+{
+	if (!m_data || offset > m_size || m_size - offset < size)
+	{
+		return false;
+	}
+
+	::memcpy(buffer, m_data + offset, static_cast<size_t>(size));
+	return true;
+}
@@ -0,0 +1,211 @@
+#include <cstring>
+
+#include "MsiTable.h"
+#include "LogHelper.h"
+#include "UnpackKernels.h"
+
+MsiTableColumn::MsiTableColumn(const BYTE* data, DWORD fieldSize, DWORD rowCount)
+	: m_data(data), m_fieldSize(fieldSize), m_rowCount(rowCount)
+{
+
+}
+
+// fields aren't aligned, so they are copied by memcpy. Row must be less than size()
+DWORD MsiTableColumn::get(DWORD row) const
+{
+	const BYTE* field = m_data + static_cast<size_t>(row) * m_fieldSize;
+	switch (m_fieldSize)
+	{
+	case sizeof(WORD):
+	{
+		WORD value = 0;
+		::memcpy(&value, field, sizeof(WORD));
+		return value;
+	}
+	case sizeof(DWORD):
+	{
+		DWORD value = 0;
+		::memcpy(&value, field, sizeof(DWORD));
+		return value;
+	}
+	default:
+	{
+		DWORD value = 0;
+		::memcpy(&value, field, m_fieldSize);
+		return value;
+	}
+	}
+}
+
+// widens values of rows [firstRow, firstRow + count) to DWORD's. Rows must be less than size()
+void MsiTableColumn::unpack(DWORD firstRow, DWORD count, DWORD* output) const
+{
+	unpackFields(m_data + static_cast<size_t>(firstRow) * m_fieldSize, m_fieldSize, count, output);
+}
+
+const BYTE* MsiTableColumn::data() const
+{
+	return m_data;
+}
+
+DWORD MsiTableColumn::fieldSize() const
+{
+	return m_fieldSize;
+}
+
+DWORD MsiTableColumn::size() const
+{
+	return m_rowCount;
+}
+
+MsiTableRow::MsiTableRow(const MsiTable* table, DWORD row)
+	: m_table(table), m_row(row)
+{
+
+}
+
+DWORD MsiTableRow::operator[](DWORD column) const
+{
+	return m_table->get(m_row, column);
+}
+
+DWORD MsiTableRow::size() const
+{
+	return m_table->columnCount();
+}
+
+/*	Stream size must be a multiple of the row size. Columns are placed one after another,
+	so column starts at its offset in the row multiplied by row count.
+*/
+bool MsiTable::init(StreamBuffer&& stream, const ColumnDescriptor* columns, DWORD columnCount, DWORD rowByteSize)
+{
+	clear();
+
+	const QWORD tableByteStreamSize = stream.size();
+	if (rowByteSize == 0)
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "Table has no columns");
+		return false;
+	}
+
+	if (tableByteStreamSize % rowByteSize)
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "Something wrong: tableByteStreamSize % oneRowByteSize = ",
+			static_cast<int>(tableByteStreamSize % rowByteSize));
+		return false;
+	}
+
+	m_rowCount = static_cast<DWORD>(tableByteStreamSize / rowByteSize);
+	m_stream = std::move(stream);
+
+	m_columns.reserve(columnCount);
+	m_columnData.reserve(columnCount);
+	for (DWORD i = 0; i < columnCount; i++)
+	{
+		const BYTE* columnData = m_stream.data() + static_cast<size_t>(columns[i].rowOffset) * m_rowCount;
+		m_columns.push_back(columns[i].info);
+		m_columnData.emplace_back(columnData, columns[i].fieldSize, m_rowCount);
+	}
+
+	return true;
+}
+
+void MsiTable::clear()
+{
+	m_stream.reset();
+	m_columns.clear();
+	m_columnData.clear();
+	m_rowCount = 0;
+}
+
+DWORD MsiTable::get(DWORD row, DWORD column) const
+{
+	return m_columnData[column].get(row);
+}
+
+MsiTableRow MsiTable::row(DWORD row) const
+{
+	return MsiTableRow(this, row);
+}
+
+const MsiTableColumn& MsiTable::column(DWORD column) const
+{
+	return m_columnData[column];
+}
+
+const std::vector<ColumnInfo>& MsiTable::getColumns() const
+{
+	return m_columns;
+}
+
+DWORD MsiTable::rowCount() const
+{
+	return m_rowCount;
+}
+
+DWORD MsiTable::columnCount() const
+{
+	return static_cast<DWORD>(m_columns.size());
+}
+
+// memory owned by the table. Stream which is a view into the mapped file isn't counted
+QWORD MsiTable::memoryUsage() const
+{
+	QWORD usage = sizeof(MsiTable) + m_columns.size() * (sizeof(ColumnInfo) + sizeof(MsiTableColumn));
+	if (!m_stream.isView())
+	{
+		usage += m_stream.size();
+	}
+	return usage;
+}
+
+/*	This function is based on research from msi.dll (with IDA). I looked on "CMsiView::GetColumnTypes" 
+	and based on that I retrieved information which I need. Because I'am not interested of many types
+	(eg. object) so I treat them like a simple numbers.
+*/
+void MsiTable::getColumnType(const WORD columnWordType, ColumnTypeInfo& columnTypeInfo)
+{
+	//1. if ( BITTEST(&type, 12) ) -> then field is nullable (can be null)
+	//2. there are other types: 'o', 'v', 'f', 'g', 'j' but for as are not important
+	columnTypeInfo.kind = ColumnKind::Unknown;
+	if (BITTEST(columnWordType, 11)) 
+	{
+		if (BITTEST(columnWordType, 10) && BITTEST(columnWordType, 8))
+		{
+			columnTypeInfo.kind = ColumnKind::OrdString;
+			if (BITTEST(columnWordType, 9))
+			{
+				columnTypeInfo.kind = ColumnKind::LocString;
+			}
+			columnTypeInfo.value = columnWordType & 0xff; //take only one byte
+		}
+	}
+	else //there is an integer
+	{
+		columnTypeInfo.kind = ColumnKind::Number;
+		columnTypeInfo.value = 4;
+
+		if (BITTEST(columnWordType, 10))
+		{
+			columnTypeInfo.value = 2;
+		}
+	}
+}
+
+/*	Size of the field in table stream. Strings are indices into the string pool (2 or 3 bytes),
+	numbers can be 2 or 4 bytes. Other types (eg. binary) are stored like a short number.
+*/
+DWORD MsiTable::getFieldSize(const ColumnTypeInfo& columnTypeInfo, DWORD stringRefSize)
+{
+	if (columnTypeInfo.kind == ColumnKind::OrdString || columnTypeInfo.kind == ColumnKind::LocString)
+	{
+		return stringRefSize;
+	}
+
+	//there is possible store DWORD. In this case we need read 4 bytes, not 2
+	if (columnTypeInfo.kind == ColumnKind::Number && columnTypeInfo.value == 4)
+	{
+		return sizeof(DWORD);
+	}
+	return sizeof(WORD);
+}
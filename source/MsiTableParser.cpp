@@ -1,6 +1,9 @@
 #include <vector>
-#include <filesystem>
-#include <regex>
+#include <memory>
+#include <cstring>
+#include <exception>
+#include <algorithm>
+#include <sstream>
 
 #include "MsiTableParser.h"
 #include "LogHelper.h"
@@ -23,16 +26,54 @@ std::map<ActionSourceType, std::string> MsiTableParser::s_mapActionScourceEnumTo
 	{ActionSourceType::Property, "Property"}
 };
 
-MsiTableParser::MsiTableParser(CfbExtractor& extractor, const std::string outDir) : m_cfbExtractor(extractor), m_outputDir(outDir),
-	m_scriptsDir(outDir + "\\scripts"), m_tablesDir(outDir + "\\tables"), m_filesDir(outDir + "\\files")
+static bool endsWith(std::string_view text, std::string_view suffix)
+{
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+MsiTableParser::MsiTableParser(CfbExtractor& extractor, OutputSink& output) : m_cfbExtractor(extractor), m_output(output),
+	m_ioBudget(Default_In_Flight_Limit), m_propertyResolver(m_mapProperties)
 {
 
 }
 
 MsiTableParser::~MsiTableParser()
 {
-	if (m_columnsByteStream)
-		delete[] m_columnsByteStream;
+
+}
+
+void MsiTableParser::setIoBufferSize(DWORD ioBufferSize)
+{
+	if (ioBufferSize > 0)
+	{
+		m_ioBufferSize = ioBufferSize;
+	}
+}
+
+// limit of bytes in copy buffers of all threads saving embedded files. One buffer is always allowed
+void MsiTableParser::setInFlightLimit(QWORD inFlightLimit)
+{
+	m_ioBudget.setLimit(inFlightLimit);
+}
+
+void MsiTableParser::setTableFormat(TableFormat tableFormat)
+{
+	m_tableFormat = tableFormat;
+}
+
+void MsiTableParser::setThreadPool(ThreadPool* threadPool)
+{
+	m_threadPool = threadPool;
+}
+
+void MsiTableParser::setTableCacheSize(QWORD tableCacheSize)
+{
+	m_tableCache.setCapacity(tableCacheSize);
+}
+
+TableCacheStats MsiTableParser::getTableCacheStats() const
+{
+	return m_tableCache.getStats();
 }
 
 /*	How I discovered that a "!_StringPool" stream contains string lengths?
@@ -51,18 +92,17 @@ bool MsiTableParser::initStringVector()
 {
 	bool status = false;
 
-	BYTE* stringDataStream = nullptr;
-	BYTE* stringPoolByteStream = nullptr;
+	StreamBuffer stringDataStream;
+	StreamBuffer stringPoolByteStream;
 
 	do {
 		//get StringData
-		DWORD stringDataStreamSize = 0;
-		ASSERT_BREAK(m_cfbExtractor.readAndAllocateStream(StringData_Stream_Name, &stringDataStream, stringDataStreamSize));
+		ASSERT_BREAK(m_cfbExtractor.readStream(StringData_Stream_Name, stringDataStream));
 
 		//if you want save stream, uncomment lines
-		/*if (stringDataStream)
+		/*if (stringDataStream.data())
 		{
-			if (writeToFile(StringData_Stream_Name, (const char*)stringDataStream, stringDataStreamSize, std::ios::binary))
+			if (writeToFile(StringData_Stream_Name, (const char*)stringDataStream.data(), stringDataStream.size()))
 			{
 				std::string msg = std::string(StringData_Stream_Name) + " written to file";
 				Log(LogLevel::Info, msg.data());
@@ -70,48 +110,15 @@ bool MsiTableParser::initStringVector()
 		}*/
 
 		//get StringPool
-		DWORD stringPoolByteStreamSize = 0;
-		ASSERT_BREAK(m_cfbExtractor.readAndAllocateStream(StringPool_Stream_Name, &stringPoolByteStream, stringPoolByteStreamSize));
-
-		m_stringCount = stringPoolByteStreamSize / sizeof(DWORD);
-
-		//if longStrings occur then we allocate to much size, but it should't be a problem
-		m_vecStrings.resize(m_stringCount);
+		ASSERT_BREAK(m_cfbExtractor.readStream(StringPool_Stream_Name, stringPoolByteStream));
 
-		WORD* stringPoolStream = (WORD*)stringPoolByteStream;
-
-		DWORD offset = 0;
-		DWORD stringIndex = 0;
-		for (DWORD i = 0; i < m_stringCount; i++)
-		{
-			WORD occuranceNumber = stringPoolStream[2 * i + 1];
-			WORD stringLength = stringPoolStream[2 * i];
-
-			if (occuranceNumber > 0)
-			{
-				if (stringLength == 0)
-				{
-					//there is long string
-					i++;
-					DWORD longStringLenght = *(((DWORD*)stringPoolStream) + i);
-					m_vecStrings[stringIndex].resize(longStringLenght);
-					::memcpy((void*)m_vecStrings[stringIndex].data(), stringDataStream + offset, longStringLenght);
-					offset += longStringLenght;
-				}
-				else if (stringLength > 0)
-				{
-					m_vecStrings[stringIndex].resize(stringLength);
-					::memcpy((void*)m_vecStrings[stringIndex].data(), stringDataStream + offset, stringLength);
-					offset += stringLength;
-				}
-			}
-			stringIndex++;
-		}
+		//strings aren't copied, pool keeps "!_StringData" buffer and offsets of strings
+		ASSERT_BREAK(m_stringPool.build(std::move(stringDataStream), stringPoolByteStream, m_threadPool));
 
 		//if you want save stream, uncomment lines
-		/*if (stringPoolByteStream)
+		/*if (stringPoolByteStream.data())
 		{
-			if (writeToFile(StringPool_Stream_Name, (const char*)stringPoolByteStream, stringPoolByteStreamSize, std::ios::binary))
+			if (writeToFile(StringPool_Stream_Name, (const char*)stringPoolByteStream.data(), stringPoolByteStream.size()))
 			{
 				std::string msg = std::string(StringPool_Stream_Name) + " written to file";
 				Log(LogLevel::Info, msg.data());
@@ -121,13 +128,6 @@ bool MsiTableParser::initStringVector()
 		status = true;
 	} while (false);
 
-	//all deletes and clean up
-	if (stringDataStream)
-		delete[] stringDataStream;
-
-	if (stringPoolByteStream)
-		delete[] stringPoolByteStream;
-
 	return status;
 }
 
@@ -136,32 +136,32 @@ bool MsiTableParser::initStringVector()
 	and that's all.
 
 	Each word means a string index in string vector. And it is table name.
+	In database with more than MAX_WORD strings indices have 3 bytes (see StringPool::stringRefSize).
 */
 bool MsiTableParser::readTableNamesFromMetadata()
 {
 	bool status = false;
 	bool breakAfterLoop = false;
-	BYTE* tablesByteStream = nullptr;
+	StreamBuffer tablesByteStream;
 
 	do {
 		//get StringData
-		DWORD tablesByteStreamSize = 0;
-		ASSERT_BREAK(m_cfbExtractor.readAndAllocateStream(Tables_Stream_Name, &tablesByteStream, tablesByteStreamSize));
+		ASSERT_BREAK(m_cfbExtractor.readStream(Tables_Stream_Name, tablesByteStream));
 
-		WORD* tablesStream = (WORD*)tablesByteStream;
-		for (DWORD i = 0; i < tablesByteStreamSize / sizeof(WORD); i++)
+		const BYTE* tablesStream = tablesByteStream.data();
+		const DWORD stringRefSize = m_stringPool.stringRefSize();
+		for (DWORD i = 0; i < tablesByteStream.size() / stringRefSize; i++)
 		{
-			WORD stringIndex = tablesStream[i];
-			ASSERT_BREAK_AFTER_LOOP_1(stringIndex < m_vecStrings.size(), breakAfterLoop);
+			DWORD stringIndex = m_stringPool.readStringRef(tablesStream + i * stringRefSize);
+			ASSERT_BREAK_AFTER_LOOP_1(stringIndex < m_stringPool.size(), breakAfterLoop);
 			m_tableNameIndices.push_back(stringIndex);
-			m_mapTNStringToTNIndex[m_vecStrings[stringIndex]] = stringIndex;
 		}
 		ASSERT_BREAK_AFTER_LOOP_2(breakAfterLoop);
 
 		//if you want save stream, uncomment lines
-		/*if (tablesByteStream)
+		/*if (tablesByteStream.data())
 		{
-			if (writeToFile(Tables_Stream_Name, (const char*)tablesByteStream, tablesByteStreamSize, std::ios::binary))
+			if (writeToFile(Tables_Stream_Name, (const char*)tablesByteStream.data(), tablesByteStream.size()))
 			{
 				std::string msg = std::string(Tables_Stream_Name) + " written to file";
 				Log(LogLevel::Info, msg.data());
@@ -178,7 +178,8 @@ bool MsiTableParser::readTableNamesFromMetadata()
 	Thanks to dynamic analysis with IDA, WIX and my insights.
 
 	STRUCTURE
-	"!_Columns" table contains all columns in msi database. Table size is 4 * sizeof(WORD) * columnsCount.
+	"!_Columns" table contains all columns in msi database. Table size is 4 * sizeof(WORD) * columnsCount
+	(or (2 * 3 + 2 * sizeof(WORD)) * columnsCount if string indices have 3 bytes).
 	Why 4? Because each column is described by 4 values. First value is a tableName. It allows match
 	column table. Second value is column index. Third is a column name and last is column type. 
 	Order in this file is strange. There is no "first column info(tableName), second column info(index), etc" but,
@@ -194,62 +195,18 @@ bool MsiTableParser::readTableNamesFromMetadata()
 bool MsiTableParser::extractColumnsFromMetadata()
 {
 	bool status = false;
+	StreamBuffer columnsByteStream;
 
 	do {
-		DWORD columnsByteStreamSize = 0;
-		ASSERT_BREAK(m_cfbExtractor.readAndAllocateStream(Columns_Stream_Name, &m_columnsByteStream, columnsByteStreamSize));
-
-		WORD* columnsStream = (WORD*)m_columnsByteStream;
+		ASSERT_BREAK(m_cfbExtractor.readStream(Columns_Stream_Name, columnsByteStream));
 
-		//note difference between tableIndex and tableNameIndex
-		DWORD tableIndex = 0;
-		DWORD columnCount = 0;
-
-		DWORD currTableNameIndex = m_tableNameIndices[0];
-		m_mapTNIndexToColumnCountAndOffset[currTableNameIndex].second = m_allColumnsCount;
-		for (DWORD i = 0; i < columnsByteStreamSize / sizeof(WORD); i++)
-		{
-			WORD stringIndex = columnsStream[i];
-			if (stringIndex == currTableNameIndex)
-			{
-				columnCount++;
-			}
-			else
-			{
-				m_allColumnsCount += columnCount;
-				m_mapTNIndexToColumnCountAndOffset[currTableNameIndex].first = columnCount;
-
-				tableIndex++;
-				if (tableIndex >= m_tableNameIndices.size())
-				{
-					//end of columns counting
-					break;
-				}
-
-				currTableNameIndex = m_tableNameIndices[tableIndex];
-				if (stringIndex != currTableNameIndex)
-				{
-					//something wrong
-					LogHelper::PrintLog(LogLevel::Warning, "Strange situation with indices in \"extractColumnsFromMetadata()\". Check it.");
-				}
-				m_mapTNIndexToColumnCountAndOffset[currTableNameIndex].second = m_allColumnsCount;
-
-				columnCount = 1;
-			}
-		}
-
-		//check if stream is correct size
-		constexpr DWORD metadataColumnCount = 4;
-		if (m_allColumnsCount * sizeof(WORD) * metadataColumnCount != columnsByteStreamSize)
-		{
-			//something wrong
-			LogHelper::PrintLog(LogLevel::Warning, "Strange situation with columnCount in \"extractColumnsFromMetadata()\". Check it.");
-		}
+		//schema of all tables is decoded once, later tables are found by name
+		ASSERT_BREAK(m_schemaCatalog.build(m_stringPool, m_tableNameIndices, columnsByteStream.data(), columnsByteStream.size()));
 
 		//if you want save stream, uncomment lines
-		/*if (m_columnsByteStream)
+		/*if (columnsByteStream.data())
 		{
-			if (writeToFile(Columns_Stream_Name, (const char*)m_columnsByteStream, columnsByteStreamSize, std::ios::binary))
+			if (writeToFile(Columns_Stream_Name, (const char*)columnsByteStream.data(), columnsByteStream.size()))
 			{
 				std::string msg = std::string(Columns_Stream_Name) + " written to file";
 				Log(LogLevel::Info, msg.data());
@@ -276,16 +233,15 @@ bool MsiTableParser::loadProperties()
 	BYTE* tableByteStream = nullptr;
 	do
 	{
-		std::vector<ColumnInfo> columns;
-		std::vector<std::vector<DWORD>> table;
-		ASSERT_BREAK(loadTable(Property_Table_Name, columns, table));
-		for (auto vec : table)
+		TypedTableView<PropertySchema> table;
+		ASSERT_BREAK(getTypedTable(table));
+		for (DWORD i = 0; i < table.rowCount(); i++)
 		{
-			ASSERT_BREAK_AFTER_LOOP_1(vec[0] < m_stringCount, breakAfterLoop);
-			std::string key = m_vecStrings[vec[0]];
+			ASSERT_BREAK_AFTER_LOOP_1(table.get<PropertySchema::Property>(i) < m_stringPool.size(), breakAfterLoop);
+			std::string_view key = table.getString<PropertySchema::Property>(i);
 
-			ASSERT_BREAK_AFTER_LOOP_1(vec[1] < m_stringCount, breakAfterLoop);
-			std::string value = m_vecStrings[vec[1]];
+			ASSERT_BREAK_AFTER_LOOP_1(table.get<PropertySchema::Value>(i) < m_stringPool.size(), breakAfterLoop);
+			std::string_view value = table.getString<PropertySchema::Value>(i);
 
 			m_mapProperties[key] = value;
 		}
@@ -316,60 +272,36 @@ bool MsiTableParser::analyzeCustomActionTable(DWORD& saveScriptsCount, DWORD& sa
 	bool breakAfterLoop = false;
 
 	BYTE* customActionByteStream = nullptr;
-	std::ofstream reportStream;
+	//report is written to the sink at the end, also if analysis breaks in the middle
+	std::ostringstream reportStream;
+	bool reportIsStarted = false;
 	do {
-		std::vector<ColumnInfo> cAColumns;
-		std::vector<std::vector<DWORD>> customActionTable;
-		ASSERT_BREAK(loadTable(CustomAction_Table_Name, cAColumns, customActionTable));
-
-		const std::string reportFileName = m_outputDir + "\\actions.txt";
-		reportStream.open(reportFileName);
-		if (!reportStream)
-		{
-			LogHelper::PrintLog(LogLevel::Error, "Cannot open \"actions.txt\" file");
-			break;
-		}
+		//types of columns are checked once, not for each row
+		TypedTableView<CustomActionSchema> customActionTable;
+		ASSERT_BREAK(getTypedTable(customActionTable));
+		reportIsStarted = true;
 
 		//analyze data in customAction table
-		const char Script_Preamble[] = "\1ScriptPreamble\2";
 		bool scriptPreambleIsPresent = false;
-		std::string scriptPreamble;
+		//views point to m_stringPool, the only copies are decoded scripts and resolved actions
+		std::string_view scriptPreamble;
+		std::string scriptContent;
+		std::string resolvedContent;
 		DWORD index = 1;
-		for (auto row : customActionTable)
+		for (DWORD rowIndex = 0; rowIndex < customActionTable.rowCount(); rowIndex++)
 		{
 			//read row
-			if (cAColumns[0].type.kind != ColumnKind::OrdString)
-			{
-				LogHelper::PrintLog(LogLevel::Warning, "First column in CustomAction should be a string");
-				ASSERT_BREAK_AFTER_LOOP_1(false, breakAfterLoop);
-			}
-			
-			std::string id = m_vecStrings[row[0]];
+			std::string id(customActionTable.getString<CustomActionSchema::Action>(rowIndex));
 			if (id.empty())
 				id = "unknown_id";
 
-			if (cAColumns[1].type.kind != ColumnKind::Number)
-			{
-				LogHelper::PrintLog(LogLevel::Warning, "Second column in CustomAction should be number");
-				ASSERT_BREAK_AFTER_LOOP_1(false, breakAfterLoop);
-			}
-			DWORD type = row[1];
+			DWORD type = customActionTable.get<CustomActionSchema::Type>(rowIndex);
 
-			if (cAColumns[2].type.kind != ColumnKind::OrdString)
-			{
-				LogHelper::PrintLog(LogLevel::Warning, "Third column in CustomAction should be a string");
-				ASSERT_BREAK_AFTER_LOOP_1(false, breakAfterLoop);
-			}
-			ASSERT_BREAK_AFTER_LOOP_1(row[2] < m_stringCount, breakAfterLoop);
-			std::string actionSource = m_vecStrings[row[2]];
+			ASSERT_BREAK_AFTER_LOOP_1(customActionTable.get<CustomActionSchema::Source>(rowIndex) < m_stringPool.size(), breakAfterLoop);
+			std::string_view actionSource = customActionTable.getString<CustomActionSchema::Source>(rowIndex);
 
-			if (cAColumns[3].type.kind != ColumnKind::OrdString)
-			{
-				LogHelper::PrintLog(LogLevel::Warning, "Fourth column in CustomAction should be a string");
-				ASSERT_BREAK_AFTER_LOOP_1(false, breakAfterLoop);
-			}
-			ASSERT_BREAK_AFTER_LOOP_1(row[3] < m_stringCount, breakAfterLoop);
-			std::string actionContent = m_vecStrings[row[3]];
+			ASSERT_BREAK_AFTER_LOOP_1(customActionTable.get<CustomActionSchema::Target>(rowIndex) < m_stringPool.size(), breakAfterLoop);
+			std::string_view actionContent = customActionTable.getString<CustomActionSchema::Target>(rowIndex);
 			//end read row
 
 			ActionSourceType actionSourceType = static_cast<ActionSourceType>(type & ActionBitMask::Source);
@@ -390,89 +322,42 @@ bool MsiTableParser::analyzeCustomActionTable(DWORD& saveScriptsCount, DWORD& sa
 				{
 					//it can be powershell
 					const char AI_DATA_SETTER[] = "AI_DATA_SETTER";
-					if (id.compare(0, sizeof(AI_DATA_SETTER) - 1, AI_DATA_SETTER) == 0)
+					PowerShellAction powerShellAction;
+					if (id.compare(0, sizeof(AI_DATA_SETTER) - 1, AI_DATA_SETTER) == 0 &&
+						parsePowerShellAction(actionContent, actionSource.compare("CustomActionData") == 0, powerShellAction))
 					{
-						if (actionSource.compare("CustomActionData") == 0)
+						if (powerShellAction.type == PowerShellActionType::Content)
 						{
-							//script
-							const char PS1_Script_Magic[] = "\1Script\2";
-							DWORD scriptMagicBegin = actionContent.find(PS1_Script_Magic);
-							if (scriptMagicBegin != std::string::npos)
+							//params and decoded script are written directly to the output buffer
+							actionTargetType = ActionTargetType::PS1Content;
+							const char Params_Header[] = "#INPUT PARAMETERS\r\n#";
+							scriptContent.clear();
+							if (powerShellAction.hasParams)
 							{
-								//this is powershell script
-								const char Params_Magic[] = "\1Params\2";
-								std::string params;
-								DWORD paramsMagicBegin = actionContent.find(Params_Magic);
-								if (paramsMagicBegin != std::string::npos)
-								{
-									DWORD paramsBegin = paramsMagicBegin + sizeof(Params_Magic) - 1;
-									ASSERT_BREAK_AFTER_LOOP_1(scriptMagicBegin > paramsBegin, breakAfterLoop);
-									params = "#INPUT PARAMETERS\r\n#" + actionContent.substr(paramsBegin, scriptMagicBegin - paramsBegin) + "\r\n";
-								}
-
-								std::string actionContentCopy = actionContent;
-
-								DWORD scriptBegin = scriptMagicBegin + sizeof(PS1_Script_Magic) - 1;
-								actionContent = actionContent.substr(scriptBegin);
-								actionTargetType = ActionTargetType::PS1Content;
-
-								DWORD scriptPreambleMagicBegin = actionContent.find(Script_Preamble, scriptBegin);
-								if (scriptPreambleMagicBegin != std::string::npos)
-								{
-									DWORD scriptPreambleBegin = scriptPreambleMagicBegin + sizeof(Script_Preamble) - 1;
-									actionContent = actionContent.substr(0, scriptPreambleMagicBegin);
-
-									if (!scriptPreambleIsPresent)
-									{
-										scriptPreamble = actionContentCopy.substr(scriptBegin + scriptPreambleBegin);
-										scriptPreambleIsPresent = true;
-									}
-								}
-								ASSERT_BREAK_AFTER_LOOP_1(transformPS1Script(actionContent, actionContent), breakAfterLoop);
-								actionContent = params + actionContent;
-
-								//add apropriate extenstion
-								if (id.size() >= 5 && id.substr(id.size() - 5, 5).compare(".psm1") == 0)
-								{
-									//nothing to do
-									
-								}
-								else if (id.size() >= 4 && id.substr(id.size() - 4, 4).compare(".ps1") == 0)
-								{
-									//nothing to do
-								}
-								else
-								{
-									id += ".ps1";
-								}
-								break;
+								scriptContent.reserve(sizeof(Params_Header) + powerShellAction.params.size() + 2 + powerShellAction.script.size());
+								scriptContent.append(Params_Header, sizeof(Params_Header) - 1);
+								scriptContent.append(powerShellAction.params);
+								scriptContent.append("\r\n");
 							}
-						}
-						const char PS1_Call_Magic[] = "\1Property\2";
-						DWORD propertyBegin = actionContent.find(PS1_Call_Magic);
+							decodePS1Script(powerShellAction.script, scriptContent);
 
-						if (propertyBegin != std::string::npos)
-						{
-							DWORD pathBegin = actionContent.find("\2", propertyBegin + 1);
-							DWORD pathEnd = actionContent.find("\1", pathBegin + 1);
-							if (pathBegin != std::string::npos && pathEnd != std::string::npos)
+							//add apropriate extenstion
+							if (!endsWith(id, ".psm1") && !endsWith(id, ".ps1"))
 							{
-								std::string actionContentCopy = actionContent;
-								actionContent = actionContent.substr(pathBegin + 1, pathEnd - pathBegin - 1);
-								actionTargetType = ActionTargetType::PS1Call;
-
-								if (!scriptPreambleIsPresent)
-								{
-									DWORD scriptPreambleMagicBegin = actionContentCopy.find(Script_Preamble, pathEnd);
-									if (scriptPreambleMagicBegin != std::string::npos)
-									{
-										DWORD scriptPreambleBegin = scriptPreambleMagicBegin + sizeof(Script_Preamble) - 1;
-										scriptPreamble = actionContentCopy.substr(scriptPreambleBegin);
-										scriptPreambleIsPresent = true;
-									}
-								}
+								id += ".ps1";
 							}
 						}
+						else
+						{
+							actionTargetType = ActionTargetType::PS1Call;
+							actionContent = powerShellAction.script;
+						}
+
+						if (powerShellAction.hasPreamble && !scriptPreambleIsPresent)
+						{
+							scriptPreamble = powerShellAction.preamble;
+							scriptPreambleIsPresent = true;
+						}
 					}	
 				}
 				break;
@@ -482,7 +367,7 @@ bool MsiTableParser::analyzeCustomActionTable(DWORD& saveScriptsCount, DWORD& sa
 					actionTargetType = ActionTargetType::JSContent;
 
 					//add apropriate extenstion
-					if (id.size() < 3 || id.substr(id.size() - 3, 3).compare(".js") != 0)
+					if (!endsWith(id, ".js"))
 					{
 						id += ".js";
 					}
@@ -494,16 +379,7 @@ bool MsiTableParser::analyzeCustomActionTable(DWORD& saveScriptsCount, DWORD& sa
 					actionTargetType = ActionTargetType::VBSContent;
 
 					//add apropriate extenstion
-					
-					if (id.size() >= 4 && id.substr(id.size() - 4, 4).compare(".vbs") == 0)
-					{
-						//nothing to do
-					}
-					else if (id.size() >= 3 && id.substr(id.size() - 3, 3).compare(".vb") == 0)
-					{
-						//nothing to do
-					}
-					else
+					if (!endsWith(id, ".vbs") && !endsWith(id, ".vb"))
 					{
 						id += ".vbs";
 					}
@@ -524,17 +400,19 @@ bool MsiTableParser::analyzeCustomActionTable(DWORD& saveScriptsCount, DWORD& sa
 			case ActionTargetType::VBSContent:
 			case ActionTargetType::PS1Content:
 			{
-				if (!std::filesystem::exists(m_scriptsDir))
+				if (actionTargetType == ActionTargetType::PS1Content)
 				{
-					if (!std::filesystem::create_directories(m_scriptsDir))
-					{
-						LogHelper::PrintLog(LogLevel::Warning, "Can't create scripts folder");
-						continue;
-					}
+					actionContent = scriptContent;
+				}
+
+				if (!m_output.createDirectory(Scripts_Dir_Name))
+				{
+					LogHelper::PrintLog(LogLevel::Warning, "Can't create scripts folder");
+					continue;
 				}
 				
-				std::string scriptPath = m_scriptsDir + "\\" + id;
-				ASSERT_BREAK_AFTER_LOOP_1(writeToFile(scriptPath, actionContent.data(), actionContent.size(), std::ios::binary), breakAfterLoop);
+				std::string scriptPath = std::string(Scripts_Dir_Name) + "\\" + id;
+				ASSERT_BREAK_AFTER_LOOP_1(writeToFile(scriptPath, actionContent.data(), actionContent.size()), breakAfterLoop);
 				saveScriptsCount++;
 				break;
 			}
@@ -542,13 +420,15 @@ bool MsiTableParser::analyzeCustomActionTable(DWORD& saveScriptsCount, DWORD& sa
 			default:
 			{
 				//dealing with properties
-				ASSERT_BREAK_AFTER_LOOP_1(useProperties(actionContent, actionContent), breakAfterLoop);
+				ASSERT_BREAK_AFTER_LOOP_1(useProperties(actionContent, resolvedContent), breakAfterLoop);
 
 				if (actionSourceType == ActionSourceType::Property)
 				{
 					if (actionTargetType == ActionTargetType::Text)
 					{
-						m_mapProperties[actionSource] = actionContent;
+						m_derivedStrings.push_back(resolvedContent);
+						m_mapProperties[actionSource] = m_derivedStrings.back();
+						m_propertyResolver.invalidate();
 					}
 					else if (m_mapProperties.count(actionSource) > 0)
 					{
@@ -558,7 +438,7 @@ bool MsiTableParser::analyzeCustomActionTable(DWORD& saveScriptsCount, DWORD& sa
 
 				reportStream << index++ << ".\tID: " << id << " \t" << s_mapActionScourceEnumToString[actionSourceType] <<
 					" = \"" << actionSource << "\" \t" << s_mapActionTargetEnumToString[actionTargetType] <<
-					" = \"" << actionContent << "\"" << std::endl;
+					" = \"" << resolvedContent << "\"" << std::endl;
 				savedActionsCount++;
 				break;
 			}
@@ -568,16 +448,13 @@ bool MsiTableParser::analyzeCustomActionTable(DWORD& saveScriptsCount, DWORD& sa
 
 		if (scriptPreambleIsPresent)
 		{
-			if (!std::filesystem::exists(m_scriptsDir))
+			if (!m_output.createDirectory(Scripts_Dir_Name))
 			{
-				if (!std::filesystem::create_directories(m_scriptsDir))
-				{
-					LogHelper::PrintLog(LogLevel::Warning, "Can't create \"scripts\" folder");
-					return false;
-				}
+				LogHelper::PrintLog(LogLevel::Warning, "Can't create \"scripts\" folder");
+				return false;
 			}
 
-			std::string scriptPreamblePath = m_scriptsDir + "\\ScriptPreamble.ps1";
+			std::string scriptPreamblePath = std::string(Scripts_Dir_Name) + "\\ScriptPreamble.ps1";
 			//if (std::filesystem::exists(scriptFolder))
 			//{
 			//	Log(LogLevel::Warning, "Scripts folder already exist.");
@@ -588,15 +465,16 @@ bool MsiTableParser::analyzeCustomActionTable(DWORD& saveScriptsCount, DWORD& sa
 			//	scriptPreamblePath += std::to_string(suffix);
 			//}
 
-			ASSERT_BREAK(transformPS1Script(scriptPreamble, scriptPreamble));
-			ASSERT_BREAK(writeToFile(scriptPreamblePath, scriptPreamble.data(), scriptPreamble.size(), std::ios::binary));
+			std::string decodedPreamble;
+			decodePS1Script(scriptPreamble, decodedPreamble);
+			ASSERT_BREAK(writeToFile(scriptPreamblePath, decodedPreamble.data(), decodedPreamble.size()));
 			saveScriptsCount++;
 		}
 
 		//if you want save stream, uncomment lines
 		/*if (customActionByteStream)
 		{
-			if (writeToFile(CustomAction_Stream_Name, (const char*)customActionByteStream, customActionByteStreamSize, std::ios::binary))
+			if (writeToFile(CustomAction_Stream_Name, (const char*)customActionByteStream, customActionByteStreamSize))
 			{
 				std::string msg = std::string(CustomAction_Stream_Name) + " written to file";
 				Log(LogLevel::Info, msg.data());
@@ -609,363 +487,298 @@ bool MsiTableParser::analyzeCustomActionTable(DWORD& saveScriptsCount, DWORD& sa
 	if (customActionByteStream)
 		delete[] customActionByteStream;
 
-	if (reportStream.is_open())
-		reportStream.close();
+	if (reportIsStarted)
+	{
+		const std::string report = reportStream.str();
+		if (!writeToFile(Actions_File_Name, report.data(), report.size()))
+		{
+			LogHelper::PrintLog(LogLevel::Error, "Cannot write \"actions.txt\" file");
+			status = false;
+		}
+	}
 
 	return status;
 }
 
-/*	Iterating by each table and saving it to file	*/
+/*	Iterating by each table and saving it to file. Tables are independent, so with the thread pool they are
+	decoded and written concurrently. Each table has its own file and its own result, so a broken table
+	doesn't stop the others and results are collected in the catalog order, the same for any number of jobs.
+*/
 bool MsiTableParser::saveAllTables(bool& AI_FileDownload_IsPresent, bool& MPB_RunActions_IsPresent, DWORD& tablesNumber)
 {
 	//create "tables" directory
-	if (!std::filesystem::exists(m_tablesDir))
+	if (!m_output.createDirectory(Tables_Dir_Name))
 	{
-		if (!std::filesystem::create_directories(m_tablesDir))
-		{
-			LogHelper::PrintLog(LogLevel::Warning, "Can't create \"tables\" dir");
-			return false;
-		}
+		LogHelper::PrintLog(LogLevel::Warning, "Can't create \"tables\" dir");
+		return false;
 	}
 	//end
 
-	for (auto i : m_mapTNStringToTNIndex)
+	std::vector<const TableDescriptor*> tablesToSave;
+	for (const TableDescriptor& table : m_schemaCatalog.getTables())
 	{
-		std::string tablePath = m_tablesDir + "\\" + i.first;
-		if (saveTable(i.first, tablePath))
+		//table name can be duplicated in crafted msi. Only the table found by name is printed
+		if (m_schemaCatalog.find(table.name) == &table)
 		{
-			tablesNumber++;
-			if (i.first.compare(AI_FileDownload_Table_Name) == 0)
-			{
-				AI_FileDownload_IsPresent = true;
-			}
-			else if (i.first.compare(MPB_RunActions_Table_Name) == 0)
-			{
-				MPB_RunActions_IsPresent = true;
-			}
+			tablesToSave.push_back(&table);
 		}
 	}
-	return true;
-}
 
-/*	Iterating by each embedded file and saving it to file	*/
-bool MsiTableParser::saveAllFiles(DWORD& savedFilesCount)
-{
-	//create "files" directory
-	if (!std::filesystem::exists(m_filesDir))
+	//vector<bool> can't be written from many threads
+	std::vector<BYTE> tableSaved(tablesToSave.size(), 0);
+	auto saveTableAt = [this, &tablesToSave, &tableSaved](QWORD index)
 	{
-		if (!std::filesystem::create_directories(m_filesDir))
+		const std::string tableName(tablesToSave[index]->name);
+		const std::string tablePath = std::string(Tables_Dir_Name) + "\\" + tableName + TableWriter::fileExtension(m_tableFormat);
+		try
 		{
-			LogHelper::PrintLog(LogLevel::Warning, "Can't create \"files\" dir");
-			return false;
+			tableSaved[index] = saveTable(tableName, tablePath) ? 1 : 0;
+		}
+		catch (const std::exception&)
+		{
+			//eg. bad_alloc for a crafted table. It can't leave the worker thread
+			std::string msg = "Cannot save \"" + tableName + "\" table";
+			LogHelper::PrintLog(LogLevel::Error, msg.data());
+		}
+	};
+
+	if (m_threadPool)
+	{
+		m_threadPool->parallelFor(tablesToSave.size(), saveTableAt);
+	}
+	else
+	{
+		for (QWORD i = 0; i < tablesToSave.size(); i++)
+		{
+			saveTableAt(i);
 		}
 	}
-	//end
 
-	//create "binaries" directory
-	if (!std::filesystem::exists(m_filesDir))
+	for (size_t i = 0; i < tablesToSave.size(); i++)
 	{
-		if (!std::filesystem::create_directories(m_filesDir))
+		if (!tableSaved[i])
 		{
-			LogHelper::PrintLog(LogLevel::Warning, "Can't create \"files\" dir");
-			return false;
+			continue;
 		}
+
+		tablesNumber++;
+		if (tablesToSave[i]->name.compare(AI_FileDownload_Table_Name) == 0)
+		{
+			AI_FileDownload_IsPresent = true;
+		}
+		else if (tablesToSave[i]->name.compare(MPB_RunActions_Table_Name) == 0)
+		{
+			MPB_RunActions_IsPresent = true;
+		}
+	}
+	return true;
+}
+
+/*	Iterating by each embedded file and saving it to file. Files are saved concurrently on the thread pool.
+	Streams which get the same file name (eg. "Binary.a" and "a") are saved by one task in the directory
+	order, so the last one wins like in the serial version.
+*/
+bool MsiTableParser::saveAllFiles(DWORD& savedFilesCount)
+{
+	//create "files" directory
+	if (!m_output.createDirectory(Files_Dir_Name))
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "Can't create \"files\" dir");
+		return false;
 	}
 	//end
 
-	const std::map<std::string, DWORD>& mapStreamNameToSectionId = m_cfbExtractor.getMapStreamNameToSectionId();
-	for (auto i : mapStreamNameToSectionId)
+	struct FileToSave
+	{
+		std::string filePath;
+		std::vector<const DirectoryNode*> streams;
+	};
+	std::vector<FileToSave> filesToSave;
+	std::map<std::string, size_t> mapFilePathToIndex;
+
+	const std::vector<DirectoryNode>& directoryNodes = m_cfbExtractor.getDirectoryIndex().getNodes();
+	for (const DirectoryNode& node : directoryNodes)
 	{
-		ASSERT_BOOL(i.first.size() > 1);
+		ASSERT_BOOL(node.name.size() > 1);
 
-		//each table streamName starts with '!'. In addition we don't want dump "Root Entry"
-		if (i.first[0] == '!' || i.first.compare("Root Entry") == 0) 
+		//each table streamName starts with '!'. Storages are not files, but their streams are dumped
+		if (node.name[0] == '!' || node.objectType != DirEntryType::Stream) 
 		{
 			continue;
 		}
 
-		std::string fileName = i.first;
+		std::string fileName = node.path;
 		
 		const char Binary_Prefix[] = "Binary.";
 		const DWORD Binary_Prefix_Len = sizeof(Binary_Prefix) - 1;
 
-		if (i.first.size() >= Binary_Prefix_Len + 1 && i.first.substr(0, Binary_Prefix_Len).compare(Binary_Prefix) == 0)
+		if (node.path.size() >= Binary_Prefix_Len + 1 && node.path.compare(0, Binary_Prefix_Len, Binary_Prefix) == 0)
 		{
 			//binary
 			fileName = fileName.substr(Binary_Prefix_Len, fileName.size() - Binary_Prefix_Len);
 		}
 
-		std::string filePath = m_filesDir + "\\" + fileName;
-		BYTE* fileStream = nullptr;
-		DWORD fileStreamSize = 0;
-		ASSERT_BREAK(m_cfbExtractor.readAndAllocateStream(i.first, &fileStream, fileStreamSize));
-		
-		if (writeToFile(filePath, (const char*)fileStream, fileStreamSize, std::ios::binary))
+		//streams from nested storages are saved as "Storage_Stream"
+		std::replace(fileName.begin(), fileName.end(), DirectoryIndex::Path_Separator, '_');
+
+		std::string filePath = std::string(Files_Dir_Name) + "\\" + fileName;
+		auto it = mapFilePathToIndex.find(filePath);
+		if (it == mapFilePathToIndex.end())
 		{
-			savedFilesCount++;
+			mapFilePathToIndex[filePath] = filesToSave.size();
+			filesToSave.push_back({ filePath, { &node } });
 		}
 		else
 		{
-			std::string msg = "Can't save " + i.first + " to file";
-			LogHelper::PrintLog(LogLevel::Warning, msg.data());
+			filesToSave[it->second].streams.push_back(&node);
 		}
-
-		delete[] fileStream;
 	}
-	return true;
-}
 
-//write to file helper
-bool MsiTableParser::writeToFile(const std::string fileName, const char* pStream, size_t streamSize, std::ios_base::openmode mod)
-{
-	std::ofstream outputFile(fileName, mod);
-	if (!outputFile)
+	std::vector<DWORD> savedStreams(filesToSave.size(), 0);
+	auto saveFileAt = [this, &filesToSave, &savedStreams](QWORD index)
 	{
-		//maybe filename is inappropriate? maybe to long?
-		std::string newFileName;
-		for (char c : fileName)
+		const FileToSave& file = filesToSave[index];
+		for (const DirectoryNode* node : file.streams)
 		{
-			if (c <= 0x20 || (c >= 0x3A && c <= 0x3F) || c >= 0x7F || c == '"' ||
-				c == '%' || c == '*' || c == ',' || c == '.' || c == '/')
+			bool saved = false;
+			try
 			{
-				//skip
-				continue;
+				saved = writeStreamToFile(file.filePath, node->path);
+			}
+			catch (const std::exception&)
+			{
+				//eg. bad_alloc. It can't leave the worker thread
+			}
+
+			if (saved)
+			{
+				savedStreams[index]++;
+			}
+			else
+			{
+				std::string msg = "Can't save " + node->path + " to file";
+				LogHelper::PrintLog(LogLevel::Warning, msg.data());
 			}
-			newFileName += c;
 		}
+	};
 
-		outputFile.open(newFileName);
-		if (!outputFile)
+	if (m_threadPool)
+	{
+		m_threadPool->parallelFor(filesToSave.size(), saveFileAt);
+	}
+	else
+	{
+		for (QWORD i = 0; i < filesToSave.size(); i++)
 		{
-			LogHelper::PrintLog(LogLevel::Warning, "Failed to create output file");
-			LogHelper::PrintLog(LogLevel::Warning, "File name lenght: ", fileName.length());
-			return false;
+			saveFileAt(i);
 		}
 	}
 
-	outputFile.write(pStream, streamSize);
-	outputFile.close();
-
+	for (DWORD savedCount : savedStreams)
+	{
+		savedFilesCount += savedCount;
+	}
 	return true;
 }
 
-bool MsiTableParser::getTableNameIndex(const std::string tableName, DWORD& index)
+//write to file helper. Path is relative to the output root
+bool MsiTableParser::writeToFile(const std::string fileName, const char* pStream, size_t streamSize)
+{
+	return m_output.writeFile(fileName, pStream, streamSize);
+}
+
+bool MsiTableParser::getTableDescriptor(const std::string tableName, const TableDescriptor*& table)
 {
-	if (m_mapTNStringToTNIndex.count(tableName) <= 0)
+	table = m_schemaCatalog.find(tableName);
+	if (!table)
 	{
 		std::string msg = tableName + " doesn't exists";
 		LogHelper::PrintLog(LogLevel::Warning, msg.data());
 		return false;
 	}
 
-	index = m_mapTNStringToTNIndex[tableName];
-
 	return true;
 }
 
-/*	This function is based on research from msi.dll (with IDA). I looked on "CMsiView::GetColumnTypes" 
-	and based on that I retrieved information which I need. Because I'am not interested of many types
-	(eg. object) so I treat them like a simple numbers.
+/*	Each property is saved like "[<property_name>]". Formatted string is resolved in one pass by
+	FormattedStringResolver (nested properties, "[[<property_name>]]" and "[\<char>]" are supported too).
 */
-void MsiTableParser::getColumnType(const WORD columnWordType, ColumnTypeInfo& columnTypeInfo)
+bool MsiTableParser::useProperties(std::string_view inputString, std::string& outputString)
 {
-	//1. if ( BITTEST(&type, 12) ) -> then field is nullable (can be null)
-	//2. there are other types: 'o', 'v', 'f', 'g', 'j' but for as are not important
-	columnTypeInfo.kind = ColumnKind::Unknown;
-	if (BITTEST(columnWordType, 11)) 
-	{
-		if (BITTEST(columnWordType, 10) && BITTEST(columnWordType, 8))
-		{
-			columnTypeInfo.kind = ColumnKind::OrdString;
-			if (BITTEST(columnWordType, 9))
-			{
-				columnTypeInfo.kind = ColumnKind::LocString;
-			}
-			columnTypeInfo.value = columnWordType & 0xff; //take only one byte
-		}
-	}
-	else //there is an integer
-	{
-		columnTypeInfo.kind = ColumnKind::Number;
-		columnTypeInfo.value = 4;
-
-		if (BITTEST(columnWordType, 10))
-		{
-			columnTypeInfo.value = 2;
-		}
-	}
+	//input can be a view of the output, so result is moved at the end
+	std::string resolvedString;
+	m_propertyResolver.resolve(inputString, resolvedString);
+	outputString = std::move(resolvedString);
+	return true;
 }
 
-/*	Ps1 scripts are store in different way than js and vbs. The script content is store as text in customAction 
-	and it coplicate many things. Some chars can't be simply saved and to mark these special chars ps1 script use
-	a scpecial construction. If '[' is present in powershell, then in custom action it is saved like "[\[]".
-	General recipe: "[\<special_char>]"
+/*	Embedded files can be huge, so they are never loaded whole into memory. If the input allows it, the stream
+	is copied without any buffer in user space (see CfbExtractor::copyStreamToFile). Otherwise it is written
+	chunk by chunk through the buffer taken from the in flight budget, shared by all threads saving files.
+	Size is known before, so the sink can stream the file also into the archive.
 */
-bool MsiTableParser::transformPS1Script(const std::string rawScript, std::string& decodedScript)
+bool MsiTableParser::writeStreamToFile(const std::string fileName, const std::string streamName)
 {
-	decodedScript.clear();
-	decodedScript.reserve(rawScript.size());
+	StreamReader reader;
+	ASSERT_BOOL(m_cfbExtractor.openStream(streamName, reader));
 
-	for (DWORD i = 0; i < rawScript.size(); i++)
+	if (m_cfbExtractor.canCopyStreamToFile())
 	{
-		if (rawScript[i] == '[')
+		return m_output.writeStreamedFile(fileName, reader.size(), [this, &streamName](OutputFile& outputFile)
 		{
-			if (rawScript.size() < i + 3)
-			{
-				LogHelper::PrintLog(LogLevel::Warning, "PS1 script is truncated");
-				return false;
-			}
-
-			if (rawScript[i + 1] == '\\' && rawScript[i + 3] == ']')
-			{
-				decodedScript += rawScript[i + 2];
-				i += 3;
-			}
-		}
-		else
-		{
-			decodedScript += rawScript[i];
-		}
+			return m_cfbExtractor.copyStreamToFile(streamName, outputFile);
+		});
 	}
 
-	return true;
-}
-
-/*	Each property is saved like "[<property_name>]". Therefore we look for this regex and replace it with
-	m_mapProperties[<property_name>].
-*/
-bool MsiTableParser::useProperties(std::string inputString, std::string& outputString)
-{
-	std::smatch property_match;
-	std::regex property_regex("(\\[)([a-zA-Z0-9_]+)(\\])");
-	if (std::regex_search(inputString, property_match, property_regex))
+	//peak memory usage is limited by the buffer size (and budget), not by the size of embedded file
+	const QWORD bufferSize = (std::min)(static_cast<QWORD>(m_ioBufferSize), reader.size());
+	ByteBudgetGuard bufferBudget(m_ioBudget, bufferSize);
+	std::unique_ptr<BYTE[]> buffer(new BYTE[static_cast<size_t>(bufferSize)]);
+	return m_output.writeStreamedFile(fileName, reader.size(), [&reader, &buffer, bufferSize](OutputFile& outputFile)
 	{
-		outputString = ""; 
-		while (std::regex_search(inputString, property_match, property_regex))
+		while (!reader.eof())
 		{
-			outputString += property_match.prefix();;
-			std::string key = property_match[2].str();
-			if (m_mapProperties.count(key) > 0)
-			{
-				outputString += m_mapProperties[key];
-			}
-			else
-			{
-				outputString += property_match[0].str();;
-			}
-			inputString = property_match.suffix();
+			QWORD readBytes = reader.read(buffer.get(), bufferSize);
+			ASSERT_BOOL(reader.good());
+			ASSERT_BOOL(outputFile.write(buffer.get(), readBytes));
 		}
-		outputString += inputString;
-	}
-	return true;
+		return true;
+	});
 }
 
-/* Method below get the tableName and return tableColumns and tableRows */
-bool MsiTableParser::loadTable(const std::string tableName, std::vector<ColumnInfo>& columns, std::vector<std::vector<DWORD>>& table)
+/* Method below get the tableName and return table with columns info. Table isn't copied, it keeps the stream */
+bool MsiTableParser::loadTable(const std::string tableName, MsiTable& table)
 {
-	bool status = false;
-	bool breakAfterLoop = false;
-
-	BYTE* tableByteStream = nullptr;
-
-	do
-	{
-		DWORD tableNameIndex = 0;
-		ASSERT_BREAK(getTableNameIndex(tableName, tableNameIndex));
-
-		ASSERT_BREAK(m_mapTNIndexToColumnCountAndOffset.count(tableNameIndex) > 0);
-		const DWORD columnCount = m_mapTNIndexToColumnCountAndOffset[tableNameIndex].first;
-		const DWORD columnOffset = m_mapTNIndexToColumnCountAndOffset[tableNameIndex].second;
-
-		columns.resize(columnCount);
-		const DWORD Index_ColumnIndex = 1;
-		const DWORD Name_ColumnIndex = 2;
-		const DWORD Type_ColumnIndex = 3;
-
-		DWORD indicesOffset = Index_ColumnIndex * m_allColumnsCount + columnOffset;
-		DWORD namesOffset = Name_ColumnIndex * m_allColumnsCount + columnOffset;
-		DWORD typesOffset = Type_ColumnIndex * m_allColumnsCount + columnOffset;
+	const TableDescriptor* tableDescriptor = nullptr;
+	ASSERT_BOOL(getTableDescriptor(tableName, tableDescriptor));
 
-		WORD* columnsStream = (WORD*)m_columnsByteStream;
-		DWORD oneRowByteSize = 0;
+	StreamBuffer tableByteStream;
+	const std::string streamName = "!" + tableName;
+	ASSERT_BOOL(m_cfbExtractor.readStream(streamName, tableByteStream));
 
-		//this loop help load columns info for CustomAction table
-		for (DWORD j = 0; j < columnCount; j++)
-		{
-			//indices. Indices have always highest bit set to 1, I don't know why. Ignore it
-			columns[j].index = columnsStream[indicesOffset + j] & 0x7fff;
-
-			//names
-			WORD nameId = columnsStream[namesOffset + j];
-			ASSERT_BREAK_AFTER_LOOP_1(nameId < m_vecStrings.size(), breakAfterLoop);
-			columns[j].name = m_vecStrings[nameId];
-
-			//types
-			getColumnType(columnsStream[typesOffset + j], columns[j].type);
-
-			//there is possible store DWORD. In this case we need read 4 bytes, not 2
-			if (columns[j].type.kind == ColumnKind::Number && columns[j].type.value == 4)
-			{
-				oneRowByteSize += 4;
-			}
-			else
-			{
-				oneRowByteSize += 2;
-			}
-		}
-		ASSERT_BREAK_AFTER_LOOP_2(breakAfterLoop);
-
-		DWORD tableByteStreamSize = 0;
-		const std::string streamName = "!" + tableName;
-		ASSERT_BREAK(m_cfbExtractor.readAndAllocateStream(streamName, &tableByteStream, tableByteStreamSize));
-
-		const DWORD rowCount = tableByteStreamSize / oneRowByteSize;
-		if (tableByteStreamSize % oneRowByteSize)
-		{
-			LogHelper::PrintLog(LogLevel::Warning, "Something wrong: tableByteStreamSize % oneRowByteSize = ",
-				tableByteStreamSize % oneRowByteSize);
-			break;
-		}
-
-		//we can allocate memory for table
-		table.resize(rowCount);
-		for (auto& vec : table)
-		{
-			vec.resize(columns.size());
-		}
-
-		BYTE* tableStream = tableByteStream;
-
-		//load table to vector
-		for (DWORD i = 0; i < columns.size(); i++)
-		{
-			DWORD fieldSize = sizeof(WORD);
-
-			//there is possible store DWORD. In this case we need read 4 bytes, not 2
-			if (columns[i].type.kind == ColumnKind::Number && columns[i].type.value == 4)
-			{
-				fieldSize = sizeof(DWORD);
-			}
-
-			for (DWORD j = 0; j < rowCount; j++)
-			{
-				::memcpy(&table[j][i], tableStream, fieldSize);
-				tableStream += fieldSize;
-			}
-		}
-
-		status = true;
-	} while (false);
-
-	while (false);
+	//columns are located in the stream by precomputed offsets, values are not copied
+	return table.init(std::move(tableByteStream), m_schemaCatalog.getColumns(*tableDescriptor),
+		tableDescriptor->columnCount, tableDescriptor->rowByteSize);
+}
 
-	if (tableByteStream)
-		delete[] tableByteStream;
+/*	Tables are taken from the cache. Only the first access decodes the table (columns info and stream).
+	Tables which failed to load aren't cached, so their errors are logged by each caller like before.
+*/
+bool MsiTableParser::getTable(const std::string tableName, std::shared_ptr<const MsiTable>& table)
+{
+	table = m_tableCache.find(tableName);
+	if (table)
+	{
+		return true;
+	}
 
-	return status;
+	std::shared_ptr<MsiTable> loadedTable = std::make_shared<MsiTable>();
+	ASSERT_BOOL(loadTable(tableName, *loadedTable));
+	table = m_tableCache.insert(tableName, std::move(loadedTable));
+	return true;
 }
 
-/* Method below get the tableName and saved table to "tablePath" */
+/* Method below get the tableName and saved table to "tablePath" in the format set by setTableFormat */
 bool MsiTableParser::saveTable(const std::string tableName, const std::string tablePath)
 {
 	std::string msg = "Printing \"" + tableName + "\" table";
@@ -973,77 +786,64 @@ bool MsiTableParser::saveTable(const std::string tableName, const std::string ta
 	bool status = false;
 	bool breakAfterLoop = false;
 
-	std::ofstream tableOutStream(tablePath);
-	if (!tableOutStream)
-	{
-		std::string msg = "Cannot open \"" + tablePath +"\" file";
-		LogHelper::PrintLog(LogLevel::Error, msg.data());
-		return false;
-	}
+	std::shared_ptr<const MsiTable> table;
+	ASSERT_BOOL(getTable(tableName, table));
+	const std::vector<ColumnInfo>& columns = table->getColumns();
+
+	TableWriter writer;
+	ASSERT_BOOL(writer.open(m_output, tablePath, m_tableFormat, columns, m_stringPool.codepage()));
 
-	BYTE* tableByteStream = nullptr;
 	do
 	{
-		std::vector<ColumnInfo> columns;
-		std::vector<std::vector<DWORD>> table;
-		ASSERT_BREAK(loadTable(tableName, columns, table));
+		//rows are unpacked in blocks. Each column of the block is widened to DWORD's at once
+		const DWORD columnCount = table->columnCount();
+		std::vector<DWORD> block(static_cast<size_t>(columnCount) * Unpack_Block_Rows);
 
-		//print column names
-		tableOutStream << "\t|\t";
-		for (auto col : columns)
+		for (DWORD blockBegin = 0; blockBegin < table->rowCount(); blockBegin += Unpack_Block_Rows)
 		{
-			tableOutStream << col.name << " \t|\t";
-		}
-		tableOutStream << "\r\n";
+			const DWORD blockRows = (std::min)(Unpack_Block_Rows, table->rowCount() - blockBegin);
+			for (DWORD i = 0; i < columnCount; i++)
+			{
+				table->column(i).unpack(blockBegin, blockRows, block.data() + i * Unpack_Block_Rows);
+			}
 
-		int index = 1;
-		for (auto vec : table)
-		{
-			tableOutStream << index++ << ".\t";
-			for (DWORD i = 0; i < vec.size(); i++)
+			for (DWORD rowIndex = 0; rowIndex < blockRows; rowIndex++)
 			{
-				const ColumnTypeInfo& t = columns[i].type;
-				if (t.kind == ColumnKind::LocString || t.kind == ColumnKind::OrdString)
+				writer.beginRow();
+				for (DWORD i = 0; i < columnCount; i++)
 				{
-					ASSERT_BREAK_AFTER_LOOP_1(vec[i] < m_vecStrings.size(), breakAfterLoop);
-					const std::string& s = m_vecStrings[vec[i]];
-					if (s.size() > t.value)
+					const ColumnTypeInfo& t = columns[i].type;
+					const DWORD value = block[i * Unpack_Block_Rows + rowIndex];
+					if (t.kind == ColumnKind::LocString || t.kind == ColumnKind::OrdString)
 					{
-						tableOutStream << s.substr(t.value);
+						ASSERT_BREAK_AFTER_LOOP_1(value < m_stringPool.size(), breakAfterLoop);
+						const std::string_view s = m_stringPool.get(value);
+						writer.writeString(s.size() > t.value ? s.substr(t.value) : s);
+					}
+					else if (t.kind == ColumnKind::Number)
+					{
+						writer.writeNumber(value);
 					}
 					else
 					{
-						tableOutStream << s;
+						//unknown type
+						writer.writeBinary(value);
 					}
-
-				}
-				else if (t.kind == ColumnKind::Number)
-				{
-					tableOutStream << vec[i];
-				}
-				else
-				{
-					//unknown type. Print it in hex
-					tableOutStream << std::hex << vec[i];
 				}
-
-				if (i != vec.size() - 1)
-					tableOutStream << " \t|\t ";
+				ASSERT_BREAK_AFTER_LOOP_2(breakAfterLoop);
+				writer.endRow();
 			}
 			ASSERT_BREAK_AFTER_LOOP_2(breakAfterLoop);
-			tableOutStream << std::endl;
 		}
+		ASSERT_BREAK_AFTER_LOOP_2(breakAfterLoop);
 
 		status = true;
 	} while (false);
 
-	while (false);
-
-	if (tableByteStream)
-		delete[] tableByteStream;
-
-	if (tableOutStream.is_open())
-		tableOutStream.close();
+	if (!writer.close())
+	{
+		status = false;
+	}
 
 	return status;
 }
\ No newline at end of file
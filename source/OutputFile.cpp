@@ -0,0 +1,157 @@
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <cstdio>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#include "OutputFile.h"
+#include "LogHelper.h"
+
+OutputFile::OutputFile()
+{
+
+}
+
+OutputFile::~OutputFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+// existing file is truncated. Errors aren't logged, because caller can try other name
+bool OutputFile::open(const std::string& path)
+{
+	close();
+
+	HANDLE fileHandle = ::CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	m_fileHandle = fileHandle;
+	return true;
+}
+
+// stdout is duplicated, so closing this file doesn't close stdout
+bool OutputFile::openStdout()
+{
+	close();
+
+	::_setmode(::_fileno(stdout), _O_BINARY);
+	HANDLE currentProcess = ::GetCurrentProcess();
+	HANDLE fileHandle = nullptr;
+	if (!::DuplicateHandle(currentProcess, ::GetStdHandle(STD_OUTPUT_HANDLE), currentProcess, &fileHandle, 0, FALSE, DUPLICATE_SAME_ACCESS))
+	{
+		return false;
+	}
+
+	m_fileHandle = fileHandle;
+	return true;
+}
+
+bool OutputFile::write(const void* data, QWORD size)
+{
+	const BYTE* input = static_cast<const BYTE*>(data);
+	while (size > 0)
+	{
+		const DWORD bytesToWrite = static_cast<DWORD>((std::min)(size, static_cast<QWORD>(0x40000000)));
+		DWORD writtenBytes = 0;
+		if (!::WriteFile(m_fileHandle, input, bytesToWrite, &writtenBytes, nullptr) || writtenBytes == 0)
+		{
+			LogHelper::PrintLog(LogLevel::Error, "WriteFile failed. Error: ", static_cast<int>(::GetLastError()));
+			return false;
+		}
+
+		input += writtenBytes;
+		size -= writtenBytes;
+	}
+	return true;
+}
+
+bool OutputFile::close()
+{
+	bool status = true;
+	if (m_fileHandle)
+	{
+		status = ::CloseHandle(m_fileHandle) != FALSE;
+	}
+
+	m_fileHandle = nullptr;
+	return status;
+}
+
+bool OutputFile::isOpen() const
+{
+	return m_fileHandle != nullptr;
+}
+#else
+// existing file is truncated. Errors aren't logged, because caller can try other name
+bool OutputFile::open(const std::string& path)
+{
+	close();
+
+	m_fileDescriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	return m_fileDescriptor >= 0;
+}
+
+// stdout is duplicated, so closing this file doesn't close stdout
+bool OutputFile::openStdout()
+{
+	close();
+
+	m_fileDescriptor = ::dup(STDOUT_FILENO);
+	return m_fileDescriptor >= 0;
+}
+
+bool OutputFile::write(const void* data, QWORD size)
+{
+	const BYTE* input = static_cast<const BYTE*>(data);
+	while (size > 0)
+	{
+		const ssize_t writtenBytes = ::write(m_fileDescriptor, input, static_cast<size_t>((std::min)(size, static_cast<QWORD>(0x40000000))));
+		if (writtenBytes <= 0)
+		{
+			if (writtenBytes < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			LogHelper::PrintLog(LogLevel::Error, "write failed. Errno: ", errno);
+			return false;
+		}
+
+		input += writtenBytes;
+		size -= writtenBytes;
+	}
+	return true;
+}
+
+bool OutputFile::close()
+{
+	bool status = true;
+	if (m_fileDescriptor >= 0)
+	{
+		status = ::close(m_fileDescriptor) == 0;
+	}
+
+	m_fileDescriptor = -1;
+	return status;
+}
+
+bool OutputFile::isOpen() const
+{
+	return m_fileDescriptor >= 0;
+}
+
+int OutputFile::descriptor() const
+{
+	return m_fileDescriptor;
+}
+#endif
@@ -0,0 +1,345 @@
+#include <ctime>
+#include <cstdio>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+
+#include "OutputSink.h"
+#include "LogHelper.h"
+
+OutputEntry::~OutputEntry()
+{
+
+}
+
+OutputSink::~OutputSink()
+{
+
+}
+
+bool OutputSink::finish()
+{
+	return true;
+}
+
+// whole content is known (eg. scripts, reports)
+bool OutputSink::writeFile(const std::string& path, const void* data, QWORD size)
+{
+	std::unique_ptr<OutputEntry> file;
+	ASSERT_BOOL(openFile(path, file));
+	if (!file->write(data, size))
+	{
+		file->close();
+		return false;
+	}
+	return file->close();
+}
+
+//file of the directory sink, written directly
+class DirectoryOutputEntry : public OutputEntry
+{
+public:
+	OutputFile m_file;
+
+	bool write(const void* data, QWORD size) override
+	{
+		return m_file.write(data, size);
+	}
+
+	bool close() override
+	{
+		return m_file.close();
+	}
+};
+
+DirectorySink::DirectorySink(const std::string& root) : m_root(root)
+{
+
+}
+
+bool DirectorySink::createDirectory(const std::string& path)
+{
+	const std::string fullPath = getFullPath(path);
+	std::error_code error;
+	if (std::filesystem::exists(fullPath, error))
+	{
+		return true;
+	}
+	return std::filesystem::create_directories(fullPath, error);
+}
+
+bool DirectorySink::openFile(const std::string& path, std::unique_ptr<OutputEntry>& file)
+{
+	std::unique_ptr<DirectoryOutputEntry> directoryFile(new DirectoryOutputEntry());
+	ASSERT_BOOL(openOutputFile(getFullPath(path), directoryFile->m_file));
+	file = std::move(directoryFile);
+	return true;
+}
+
+bool DirectorySink::writeStreamedFile(const std::string& path, QWORD size, const std::function<bool(OutputFile&)>& writeContent)
+{
+	OutputFile outputFile;
+	ASSERT_BOOL(openOutputFile(getFullPath(path), outputFile));
+	ASSERT_BOOL(writeContent(outputFile));
+	return outputFile.close();
+}
+
+std::string DirectorySink::getFullPath(const std::string& path) const
+{
+	return m_root + "\\" + path;
+}
+
+//file name without chars which often can't be used in file names
+static std::string removeUnsafeChars(const std::string& fileName)
+{
+	std::string newFileName;
+	for (char c : fileName)
+	{
+		if (c <= 0x20 || (c >= 0x3A && c <= 0x3F) || c >= 0x7F || c == '"' ||
+			c == '%' || c == '*' || c == ',' || c == '.' || c == '/')
+		{
+			//skip
+			continue;
+		}
+		newFileName += c;
+	}
+	return newFileName;
+}
+
+//open output file helper
+bool DirectorySink::openOutputFile(const std::string& path, OutputFile& outputFile) const
+{
+	if (!outputFile.open(path))
+	{
+		//maybe filename is inappropriate? maybe to long?
+		if (!outputFile.open(removeUnsafeChars(path)))
+		{
+			LogHelper::PrintLog(LogLevel::Warning, "Failed to create output file");
+			LogHelper::PrintLog(LogLevel::Warning, "File name lenght: ", static_cast<int>(path.length()));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//file of the tar sink. Size must be known before the content, so content is kept in memory until close
+class TarOutputEntry : public OutputEntry
+{
+private:
+	TarSink& m_sink;
+	const std::string m_path;
+	std::vector<BYTE> m_content;
+	bool m_closed = false;
+
+public:
+	TarOutputEntry(TarSink& sink, const std::string& path) : m_sink(sink), m_path(path)
+	{
+
+	}
+
+	~TarOutputEntry() override
+	{
+		if (!m_closed)
+		{
+			close();
+		}
+	}
+
+	bool write(const void* data, QWORD size) override
+	{
+		const BYTE* input = static_cast<const BYTE*>(data);
+		m_content.insert(m_content.end(), input, input + size);
+		return true;
+	}
+
+	bool close() override
+	{
+		m_closed = true;
+		return m_sink.writeEntry(m_path, m_content.data(), m_content.size());
+	}
+};
+
+TarSink::TarSink()
+{
+	m_modificationTime = static_cast<QWORD>(std::time(nullptr));
+}
+
+bool TarSink::open(const std::string& path)
+{
+	if (!m_output.open(path))
+	{
+		std::string msg = "Cannot open \"" + path + "\" file";
+		LogHelper::PrintLog(LogLevel::Error, msg.data());
+		return false;
+	}
+	return true;
+}
+
+bool TarSink::openStdout()
+{
+	if (!m_output.openStdout())
+	{
+		LogHelper::PrintLog(LogLevel::Error, "Cannot write to stdout");
+		return false;
+	}
+	return true;
+}
+
+// each level of the path gets its own entry, once
+bool TarSink::createDirectory(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ASSERT_BOOL(!m_failed);
+
+	for (size_t separator = path.find('\\'); ; separator = path.find('\\', separator + 1))
+	{
+		const std::string directory = path.substr(0, separator);
+		if (m_directories.insert(directory).second && !writeHeader(getEntryName(directory) + "/", '5', 0))
+		{
+			m_failed = true;
+			return false;
+		}
+
+		if (separator == std::string::npos)
+		{
+			break;
+		}
+	}
+	return true;
+}
+
+bool TarSink::openFile(const std::string& path, std::unique_ptr<OutputEntry>& file)
+{
+	file.reset(new TarOutputEntry(*this, path));
+	return true;
+}
+
+/*	Archive is held during writing, so big embedded files are streamed (or copied by the kernel) without any buffer.
+	If writing fails in the middle, the size in the header is wrong and the rest of the archive would be
+	unreadable, so nothing more is written.
+*/
+bool TarSink::writeStreamedFile(const std::string& path, QWORD size, const std::function<bool(OutputFile&)>& writeContent)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ASSERT_BOOL(!m_failed);
+
+	if (!writeHeader(getEntryName(path), '0', size) || !writeContent(m_output) || !writePadding(size))
+	{
+		LogHelper::PrintLog(LogLevel::Error, "TarSink - entry is broken, archive is truncated");
+		m_failed = true;
+		return false;
+	}
+	return true;
+}
+
+bool TarSink::writeEntry(const std::string& path, const void* data, QWORD size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ASSERT_BOOL(!m_failed);
+
+	if (!writeHeader(getEntryName(path), '0', size) || !m_output.write(data, size) || !writePadding(size))
+	{
+		m_failed = true;
+		return false;
+	}
+	return true;
+}
+
+// end of archive is marked by two empty blocks
+bool TarSink::finish()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_failed)
+	{
+		const BYTE endBlocks[Block_Size * 2] = { 0 };
+		m_failed = !m_output.write(endBlocks, sizeof(endBlocks));
+	}
+
+	if (!m_output.close())
+	{
+		m_failed = true;
+	}
+	return !m_failed;
+}
+
+// names longer than the ustar name field are given in the preceding GNU long name entry
+bool TarSink::writeHeader(const std::string& name, char type, QWORD size)
+{
+	const DWORD Name_Field_Size = 100;
+	if (name.size() > Name_Field_Size)
+	{
+		const char Long_Name_Entry[] = "././@LongLink";
+		ASSERT_BOOL(writeHeaderBlock(Long_Name_Entry, 'L', name.size() + 1));
+		ASSERT_BOOL(m_output.write(name.data(), name.size() + 1));
+		ASSERT_BOOL(writePadding(name.size() + 1));
+	}
+	return writeHeaderBlock(name.substr(0, Name_Field_Size), type, size);
+}
+
+bool TarSink::writeHeaderBlock(const std::string& name, char type, QWORD size)
+{
+	//offsets of ustar header fields
+	const DWORD Mode_Offset = 100;
+	const DWORD Uid_Offset = 108;
+	const DWORD Gid_Offset = 116;
+	const DWORD Size_Offset = 124;
+	const DWORD Time_Offset = 136;
+	const DWORD Checksum_Offset = 148;
+	const DWORD Type_Offset = 156;
+	const DWORD Magic_Offset = 257;
+	const QWORD Max_Octal_Size = 077777777777ULL;
+
+	char header[Block_Size] = { 0 };
+	::memcpy(header, name.data(), (std::min)(name.size(), static_cast<size_t>(100)));
+	::snprintf(header + Mode_Offset, 8, "%07o", type == '5' ? 0755 : 0644);
+	::snprintf(header + Uid_Offset, 8, "%07o", 0);
+	::snprintf(header + Gid_Offset, 8, "%07o", 0);
+	::snprintf(header + Time_Offset, 12, "%011llo", static_cast<unsigned long long>(m_modificationTime & Max_Octal_Size));
+
+	if (size <= Max_Octal_Size)
+	{
+		::snprintf(header + Size_Offset, 12, "%011llo", static_cast<unsigned long long>(size));
+	}
+	else
+	{
+		//base-256: the highest bit of the first byte is set, value is big endian
+		header[Size_Offset] = static_cast<char>(0x80);
+		for (DWORD i = 0; i < 8; i++)
+		{
+			header[Size_Offset + 11 - i] = static_cast<char>((size >> (i * 8)) & 0xFF);
+		}
+	}
+
+	header[Type_Offset] = type;
+	::memcpy(header + Magic_Offset, "ustar\0" "00", 8);
+
+	//checksum is counted with spaces in its own field
+	::memset(header + Checksum_Offset, ' ', 8);
+	DWORD checksum = 0;
+	for (char c : header)
+	{
+		checksum += static_cast<BYTE>(c);
+	}
+	::snprintf(header + Checksum_Offset, 8, "%06o", checksum);
+	header[Checksum_Offset + 7] = ' ';
+
+	return m_output.write(header, sizeof(header));
+}
+
+// content of each entry is padded with zeros to the full block
+bool TarSink::writePadding(QWORD size)
+{
+	const BYTE zeros[Block_Size] = { 0 };
+	const QWORD paddingSize = (Block_Size - size % Block_Size) % Block_Size;
+	return paddingSize == 0 || m_output.write(zeros, paddingSize);
+}
+
+// paths in the archive use '/'
+std::string TarSink::getEntryName(const std::string& path)
+{
+	std::string entryName = path;
+	std::replace(entryName.begin(), entryName.end(), '\\', '/');
+	return entryName;
+}
@@ -0,0 +1,126 @@
+#include <algorithm>
+
+#include "PowerShellAction.h"
+
+static constexpr std::string_view Script_Magic = "\1Script\2";
+static constexpr std::string_view Params_Magic = "\1Params\2";
+static constexpr std::string_view Script_Preamble_Magic = "\1ScriptPreamble\2";
+static constexpr std::string_view Property_Magic = "\1Property\2";
+
+static bool startsWith(std::string_view text, size_t offset, std::string_view prefix)
+{
+	return text.size() - offset >= prefix.size() && text.compare(offset, prefix.size(), prefix) == 0;
+}
+
+/*	All markers begin with '\1', so they are located in one pass over the '\1' chars. Script content has
+	priority over script call, but it is accepted only if "contentAllowed" is set (only "CustomActionData"
+	property keeps the script content). Returns false if the action isn't a powershell one.
+*/
+bool parsePowerShellAction(std::string_view actionData, bool contentAllowed, PowerShellAction& action)
+{
+	constexpr size_t Not_Found = std::string_view::npos;
+	action = PowerShellAction();
+
+	size_t scriptMagic = Not_Found;
+	size_t paramsMagic = Not_Found;
+	size_t propertyMagic = Not_Found;
+	size_t pathEnd = Not_Found;
+	size_t preambleAfterScript = Not_Found;
+	size_t preambleAfterPath = Not_Found;
+
+	for (size_t pos = actionData.find('\1'); pos != Not_Found; pos = actionData.find('\1', pos + 1))
+	{
+		//path of called script ends on the first '\1' after the property marker
+		if (propertyMagic != Not_Found && pathEnd == Not_Found)
+		{
+			pathEnd = pos;
+		}
+
+		if (startsWith(actionData, pos, Script_Preamble_Magic))
+		{
+			if (scriptMagic != Not_Found && preambleAfterScript == Not_Found)
+			{
+				preambleAfterScript = pos;
+			}
+			if (pathEnd != Not_Found && preambleAfterPath == Not_Found)
+			{
+				preambleAfterPath = pos;
+			}
+		}
+		else if (scriptMagic == Not_Found && startsWith(actionData, pos, Script_Magic))
+		{
+			scriptMagic = pos;
+		}
+		else if (paramsMagic == Not_Found && startsWith(actionData, pos, Params_Magic))
+		{
+			paramsMagic = pos;
+		}
+		else if (propertyMagic == Not_Found && startsWith(actionData, pos, Property_Magic))
+		{
+			propertyMagic = pos;
+		}
+	}
+
+	size_t preambleMagic = Not_Found;
+	if (contentAllowed && scriptMagic != Not_Found)
+	{
+		action.type = PowerShellActionType::Content;
+
+		//params are valid only before the script
+		if (paramsMagic != Not_Found && paramsMagic + Params_Magic.size() <= scriptMagic)
+		{
+			const size_t paramsBegin = paramsMagic + Params_Magic.size();
+			action.params = actionData.substr(paramsBegin, scriptMagic - paramsBegin);
+			action.hasParams = true;
+		}
+
+		const size_t scriptBegin = scriptMagic + Script_Magic.size();
+		action.script = actionData.substr(scriptBegin, (std::min)(preambleAfterScript, actionData.size()) - scriptBegin);
+		preambleMagic = preambleAfterScript;
+	}
+	else if (propertyMagic != Not_Found && pathEnd != Not_Found)
+	{
+		action.type = PowerShellActionType::Call;
+
+		const size_t pathBegin = propertyMagic + Property_Magic.size();
+		action.script = actionData.substr(pathBegin, pathEnd - pathBegin);
+		preambleMagic = preambleAfterPath;
+	}
+	else
+	{
+		return false;
+	}
+
+	if (preambleMagic != Not_Found)
+	{
+		action.preamble = actionData.substr(preambleMagic + Script_Preamble_Magic.size());
+		action.hasPreamble = true;
+	}
+
+	return true;
+}
+
+/*	Ps1 scripts are store in different way than js and vbs. The script content is store as text in customAction
+	and it coplicate many things. Some chars can't be simply saved and to mark these special chars ps1 script use
+	a scpecial construction. If '[' is present in powershell, then in custom action it is saved like "[\[]".
+	General recipe: "[\<special_char>]"
+	Decoded script is appended to "decodedScript", spans between escapes are copied at once.
+*/
+void decodePS1Script(std::string_view rawScript, std::string& decodedScript)
+{
+	decodedScript.reserve(decodedScript.size() + rawScript.size());
+
+	size_t copiedEnd = 0;
+	for (size_t i = rawScript.find('['); i != std::string_view::npos; i = rawScript.find('[', i + 1))
+	{
+		//'[' which doesn't start an escape is a regular char
+		if (i + 3 < rawScript.size() && rawScript[i + 1] == '\\' && rawScript[i + 3] == ']')
+		{
+			decodedScript.append(rawScript.data() + copiedEnd, i - copiedEnd);
+			decodedScript += rawScript[i + 2];
+			i += 3;
+			copiedEnd = i + 1;
+		}
+	}
+	decodedScript.append(rawScript.data() + copiedEnd, rawScript.size() - copiedEnd);
+}
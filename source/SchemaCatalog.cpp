@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include "SchemaCatalog.h"
+#include "LogHelper.h"
+#include "hashHelper.h"
+
+/*	"!_Columns" is stored column by column: table names, column indices, column names and column types.
+	Rows of one table are next to each other, so each run of the same table name gives columns of this table.
+	Table is matched by its string index, not by the position in "!_Tables".
+*/
+bool SchemaCatalog::build(const StringPool& stringPool, const std::vector<DWORD>& tableNameIndices, const BYTE* columnsStream, QWORD columnsStreamSize)
+{
+	clear();
+
+	const DWORD stringRefSize = stringPool.stringRefSize();
+	const DWORD metadataRowSize = 2 * stringRefSize + 2 * sizeof(WORD);
+	const DWORD metadataRowCount = static_cast<DWORD>(columnsStreamSize / metadataRowSize);
+
+	//check if stream is correct size
+	if (columnsStreamSize % metadataRowSize)
+	{
+		//something wrong
+		LogHelper::PrintLog(LogLevel::Warning, "Strange situation with columnCount in \"extractColumnsFromMetadata()\". Check it.");
+	}
+
+	//key: tableNameIndex, value: index in m_tables
+	std::unordered_map<DWORD, DWORD> tablesByNameIndex;
+	m_tables.reserve(tableNameIndices.size());
+	for (DWORD nameIndex : tableNameIndices)
+	{
+		if (tablesByNameIndex.count(nameIndex) > 0)
+		{
+			continue;
+		}
+		tablesByNameIndex[nameIndex] = static_cast<DWORD>(m_tables.size());
+		m_tables.push_back({ stringPool.get(nameIndex), nameIndex, 0, 0, 0 });
+	}
+
+	//byte offsets of "!_Columns" columns. Table names and column names are string indices, the rest are WORDs
+	const BYTE* tableNames = columnsStream;
+	const BYTE* indices = tableNames + metadataRowCount * stringRefSize;
+	const BYTE* names = indices + metadataRowCount * sizeof(WORD);
+	const BYTE* types = names + metadataRowCount * stringRefSize;
+
+	m_columns.reserve(metadataRowCount);
+	TableDescriptor* currentTable = nullptr;
+	DWORD currentNameIndex = 0;
+	for (DWORD i = 0; i < metadataRowCount; i++)
+	{
+		const DWORD nameIndex = stringPool.readStringRef(tableNames + i * stringRefSize);
+		if (!currentTable || nameIndex != currentNameIndex)
+		{
+			currentNameIndex = nameIndex;
+			currentTable = nullptr;
+
+			auto found = tablesByNameIndex.find(nameIndex);
+			if (found == tablesByNameIndex.end() || m_tables[found->second].columnCount > 0)
+			{
+				//columns of unknown table or the second run of columns of the same table
+				LogHelper::PrintLog(LogLevel::Warning, "Strange situation with indices in \"extractColumnsFromMetadata()\". Check it.");
+				continue;
+			}
+
+			currentTable = &m_tables[found->second];
+			currentTable->firstColumn = static_cast<DWORD>(m_columns.size());
+		}
+		else if (!currentTable)
+		{
+			continue;
+		}
+
+		ColumnDescriptor column = {};
+		WORD index = 0;
+		::memcpy(&index, indices + i * sizeof(WORD), sizeof(WORD));
+
+		//indices. Indices have always highest bit set to 1, I don't know why. Ignore it
+		column.info.index = index & 0x7fff;
+
+		//names
+		const DWORD columnNameIndex = stringPool.readStringRef(names + i * stringRefSize);
+		if (columnNameIndex >= stringPool.size())
+		{
+			LogHelper::PrintLog(LogLevel::Error, "SchemaCatalog - column name is out of string pool. Index: ", columnNameIndex);
+			return false;
+		}
+		column.info.name = stringPool.get(columnNameIndex);
+
+		//types
+		WORD type = 0;
+		::memcpy(&type, types + i * sizeof(WORD), sizeof(WORD));
+		MsiTable::getColumnType(type, column.info.type);
+
+		//layout of the row
+		column.fieldSize = MsiTable::getFieldSize(column.info.type, stringRefSize);
+		column.rowOffset = currentTable->rowByteSize;
+		currentTable->rowByteSize += column.fieldSize;
+		currentTable->columnCount++;
+
+		m_columns.push_back(column);
+	}
+
+	//the same order as names, so tables are printed alphabetically. Tables with equal names keep "!_Tables" order
+	std::stable_sort(m_tables.begin(), m_tables.end(),
+		[](const TableDescriptor& a, const TableDescriptor& b) { return a.name < b.name; });
+
+	//different string indices with the same name. The last one in "!_Tables" wins (like the name map did before)
+	std::vector<TableDescriptor> uniqueTables;
+	uniqueTables.reserve(m_tables.size());
+	for (size_t i = 0; i < m_tables.size(); i++)
+	{
+		if (i + 1 < m_tables.size() && m_tables[i + 1].name == m_tables[i].name)
+		{
+			std::string msg = "SchemaCatalog - duplicated table name: " + std::string(m_tables[i].name);
+			LogHelper::PrintLog(LogLevel::Warning, msg.data());
+			continue;
+		}
+		uniqueTables.push_back(m_tables[i]);
+	}
+	m_tables.swap(uniqueTables);
+
+	buildHashTable();
+	return true;
+}
+
+void SchemaCatalog::clear()
+{
+	m_tables.clear();
+	m_columns.clear();
+	m_slots.clear();
+	m_slotMask = 0;
+}
+
+// returns nullptr if there is no table with this name
+const TableDescriptor* SchemaCatalog::find(std::string_view tableName) const
+{
+	if (m_slots.empty())
+	{
+		return nullptr;
+	}
+
+	for (QWORD slot = hashString(tableName) & m_slotMask; m_slots[slot] != Empty_Slot; slot = (slot + 1) & m_slotMask)
+	{
+		const TableDescriptor& table = m_tables[m_slots[slot]];
+		if (table.name == tableName)
+		{
+			return &table;
+		}
+	}
+	return nullptr;
+}
+
+// columns of the table are placed one after another, table.columnCount of them
+const ColumnDescriptor* SchemaCatalog::getColumns(const TableDescriptor& table) const
+{
+	return m_columns.data() + table.firstColumn;
+}
+
+const std::vector<TableDescriptor>& SchemaCatalog::getTables() const
+{
+	return m_tables;
+}
+
+/*	Linear probing with load factor at most 0.5. Catalog is built once and never modified,
+	so we don't need deletion markers.
+*/
+void SchemaCatalog::buildHashTable()
+{
+	QWORD slotCount = 16;
+	while (slotCount < static_cast<QWORD>(m_tables.size()) * 2)
+	{
+		slotCount *= 2;
+	}
+	m_slots.assign(static_cast<size_t>(slotCount), Empty_Slot);
+	m_slotMask = slotCount - 1;
+
+	//names are unique (see build)
+	for (DWORD i = 0; i < m_tables.size(); i++)
+	{
+		QWORD slot = hashString(m_tables[i].name) & m_slotMask;
+		while (m_slots[slot] != Empty_Slot)
+		{
+			slot = (slot + 1) & m_slotMask;
+		}
+		m_slots[slot] = i;
+	}
+}
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cstring>
+
+#include "SectorCache.h"
+
+// capacity is given in bytes. 0 disables the cache, but statistics are still counted
+void SectorCache::init(const ByteSource* source, QWORD capacity)
+{
+	m_source = source;
+	m_hits = 0;
+	m_misses = 0;
+	m_bytesRead = 0;
+	m_bytesRequested = 0;
+	setCapacity(capacity);
+}
+
+void SectorCache::setCapacity(QWORD capacity)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_capacityBlocks = capacity / Block_Size;
+	m_blocks.clear();
+	m_blockMap.clear();
+}
+
+// views into the source memory (mapped file) are not copied by cache, but they are counted as read bytes
+void SectorCache::noteDirectAccess(QWORD size) const
+{
+	m_bytesRead += size;
+	m_bytesRequested += size;
+}
+
+SectorCacheStats SectorCache::getStats() const
+{
+	return { m_hits, m_misses, m_bytesRead, m_bytesRequested };
+}
+
+QWORD SectorCache::size() const
+{
+	return m_source ? m_source->size() : 0;
+}
+
+bool SectorCache::read(QWORD offset, void* buffer, QWORD size) const
+{
+	if (!m_source)
+	{
+		return false;
+	}
+	m_bytesRequested += size;
+
+	if (m_capacityBlocks == 0 || size > m_capacityBlocks * Block_Size / 4)
+	{
+		m_bytesRead += size;
+		return m_source->read(offset, buffer, size);
+	}
+
+	if (offset > m_source->size() || m_source->size() - offset < size)
+	{
+		return false;
+	}
+
+	BYTE* output = static_cast<BYTE*>(buffer);
+	while (size > 0)
+	{
+		const QWORD offsetInBlock = offset % Block_Size;
+		const QWORD bytesInBlock = (std::min)(size, Block_Size - offsetInBlock);
+		ASSERT_BOOL(readBlock(offset / Block_Size, offsetInBlock, output, bytesInBlock));
+
+		output += bytesInBlock;
+		offset += bytesInBlock;
+		size -= bytesInBlock;
+	}
+	return true;
+}
+
+const BYTE* SectorCache::data() const
+{
+	return m_source ? m_source->data() : nullptr;
+}
+
+bool SectorCache::supportsFileCopy() const
+{
+	return m_source && m_source->supportsFileCopy();
+}
+
+// copied bytes don't go through the cache (like big reads), so they don't evict tables
+bool SectorCache::copyToFile(QWORD offset, QWORD size, OutputFile& output) const
+{
+	if (!m_source)
+	{
+		return false;
+	}
+
+	m_bytesRequested += size;
+	m_bytesRead += size;
+	return m_source->copyToFile(offset, size, output);
+}
+
+/*	Block is reserved as "in flight" and read without the lock, so misses of other blocks don't wait for it.
+	Thread which needs a block being read waits for it, so two threads never read the same block twice.
+	If the read fails, waiting thread tries to read the block itself.
+	The last block of the file can be shorter than Block_Size.
+*/
+bool SectorCache::readBlock(QWORD blockIndex, QWORD offsetInBlock, BYTE* buffer, QWORD size) const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		auto found = m_blockMap.find(blockIndex);
+		if (found != m_blockMap.end())
+		{
+			m_blocks.splice(m_blocks.begin(), m_blocks, found->second);
+			::memcpy(buffer, found->second->data.get() + offsetInBlock, static_cast<size_t>(size));
+			m_hits++;
+			return true;
+		}
+
+		if (m_blocksInFlight.count(blockIndex) == 0)
+		{
+			break;
+		}
+		m_blockReady.wait(lock);
+	}
+	m_blocksInFlight.insert(blockIndex);
+	lock.unlock();
+
+	const QWORD blockOffset = blockIndex * Block_Size;
+	const QWORD blockSize = (std::min)(static_cast<QWORD>(Block_Size), m_source->size() - blockOffset);
+	std::unique_ptr<BYTE[]> blockData(new BYTE[Block_Size]);
+	const bool status = m_source->read(blockOffset, blockData.get(), blockSize);
+	if (status)
+	{
+		m_misses++;
+		m_bytesRead += blockSize;
+		::memcpy(buffer, blockData.get() + offsetInBlock, static_cast<size_t>(size));
+	}
+
+	lock.lock();
+	m_blocksInFlight.erase(blockIndex);
+	if (status)
+	{
+		if (m_blocks.size() >= m_capacityBlocks && !m_blocks.empty())
+		{
+			m_blockMap.erase(m_blocks.back().index);
+			m_blocks.pop_back();
+		}
+		m_blocks.push_front({ blockIndex, std::move(blockData) });
+		m_blockMap[blockIndex] = m_blocks.begin();
+	}
+	lock.unlock();
+	m_blockReady.notify_all();
+	return status;
+}
@@ -0,0 +1,49 @@
+#include "SectorLocator.h"
+
+void SectorLocator::initRegular(DWORD sectionSize)
+{
+	m_sectionSize = sectionSize;
+	m_containerSectionSize = sectionSize;
+	m_containerSectors = nullptr;
+	m_containerSectorCount = 0;
+}
+
+void SectorLocator::initMini(DWORD miniSectionSize, DWORD sectionSize, const DWORD* miniStreamSectors, DWORD miniStreamSectorCount)
+{
+	m_sectionSize = miniSectionSize;
+	m_containerSectionSize = sectionSize;
+	m_containerSectors = miniStreamSectors;
+	m_containerSectorCount = miniStreamSectorCount;
+}
+
+// returns false if mini sector is behind the end of mini stream
+bool SectorLocator::getOffset(DWORD sector, QWORD& offset) const
+{
+	if (!m_containerSectors)
+	{
+		//first sector in the file is a header
+		offset = static_cast<QWORD>(sector + 1ULL) * m_sectionSize;
+		return true;
+	}
+
+	//mini sector size divides sector size, so mini sector never crosses the sector boundary
+	const QWORD miniStreamOffset = static_cast<QWORD>(sector) * m_sectionSize;
+	const QWORD containerIndex = miniStreamOffset / m_containerSectionSize;
+	if (containerIndex >= m_containerSectorCount)
+	{
+		return false;
+	}
+
+	offset = (m_containerSectors[containerIndex] + 1ULL) * m_containerSectionSize + miniStreamOffset % m_containerSectionSize;
+	return true;
+}
+
+DWORD SectorLocator::sectionSize() const
+{
+	return m_sectionSize;
+}
+
+bool SectorLocator::isMini() const
+{
+	return m_containerSectors != nullptr;
+}
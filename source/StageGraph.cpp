@@ -0,0 +1,222 @@
+#include <chrono>
+#include <exception>
+
+#include "StageGraph.h"
+#include "LogHelper.h"
+
+StageGraph::StageGraph()
+{
+
+}
+
+// dependencies are ids returned by earlier calls, so the graph can't have cycles
+StageGraph::StageId StageGraph::addStage(const std::string& name, std::function<bool()> action, const std::vector<StageId>& dependencies)
+{
+	const StageId stageId = static_cast<StageId>(m_stages.size());
+	Stage stage;
+	stage.name = name;
+	stage.action = std::move(action);
+	for (StageId dependency : dependencies)
+	{
+		if (dependency >= stageId)
+		{
+			LogHelper::PrintLog(LogLevel::Warning, "StageGraph - dependency is not declared before the stage: ", dependency);
+			continue;
+		}
+		m_stages[dependency].dependents.push_back(stageId);
+		stage.pendingDependencies++;
+	}
+	m_stages.push_back(std::move(stage));
+	return stageId;
+}
+
+/*	Returns true if all stages succeeded. Outcome of each stage is logged when it is known.
+	Each stage which becomes ready gets one helper task in the pool. Helper runs any ready stage (the oldest
+	one first), or nothing if the calling thread was faster.
+*/
+bool StageGraph::run(ThreadPool* threadPool)
+{
+	std::shared_ptr<RunState> state = std::make_shared<RunState>();
+	for (StageId stage = 0; stage < m_stages.size(); stage++)
+	{
+		m_stages[stage].status = StageStatus::Pending;
+		if (m_stages[stage].pendingDependencies == 0)
+		{
+			state->readyStages.insert(stage);
+		}
+	}
+
+	//calling thread takes one of them
+	if (!state->readyStages.empty())
+	{
+		submitHelpers(state, static_cast<DWORD>(state->readyStages.size() - 1), threadPool);
+	}
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	while (state->finishedCount < m_stages.size())
+	{
+		if (!state->readyStages.empty())
+		{
+			const StageId stage = *state->readyStages.begin();
+			state->readyStages.erase(state->readyStages.begin());
+			lock.unlock();
+			runStage(state, stage, threadPool);
+			lock.lock();
+		}
+		else
+		{
+			state->stageFinished.wait(lock);
+		}
+	}
+	lock.unlock();
+
+	bool status = true;
+	for (const Stage& stage : m_stages)
+	{
+		if (stage.status != StageStatus::Succeeded)
+		{
+			status = false;
+		}
+	}
+	return status;
+}
+
+StageStatus StageGraph::getStatus(StageId stage) const
+{
+	return stage < m_stages.size() ? m_stages[stage].status : StageStatus::Pending;
+}
+
+void StageGraph::runStage(const std::shared_ptr<RunState>& state, StageId stage, ThreadPool* threadPool)
+{
+	const bool succeeded = executeStage(stage);
+	const DWORD newlyReady = finishStage(*state, stage, succeeded);
+
+	//this thread takes the next stage itself (if it isn't the calling one, it goes back to the pool)
+	if (newlyReady > 1)
+	{
+		submitHelpers(state, newlyReady - 1, threadPool);
+	}
+	if (newlyReady > 0)
+	{
+		StageId nextStage = 0;
+		if (takeReadyStage(*state, nextStage))
+		{
+			runStage(state, nextStage, threadPool);
+		}
+	}
+}
+
+// exception is treated like a failure of the stage, so other stages can finish
+bool StageGraph::executeStage(StageId stage)
+{
+	const Stage& currentStage = m_stages[stage];
+	const auto startTime = std::chrono::steady_clock::now();
+
+	bool succeeded = false;
+	try
+	{
+		succeeded = currentStage.action();
+	}
+	catch (const std::exception& exception)
+	{
+		std::string msg = "Stage \"" + currentStage.name + "\" - exception: " + exception.what();
+		LogHelper::PrintLog(LogLevel::Error, msg.data());
+	}
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+	if (succeeded)
+	{
+		std::string msg = "Successful " + currentStage.name + " (" + std::to_string(elapsed.count()) + " ms)";
+		LogHelper::PrintLog(LogLevel::Info, msg.data());
+	}
+	else
+	{
+		std::string msg = "Failed " + currentStage.name + " (" + std::to_string(elapsed.count()) + " ms)";
+		LogHelper::PrintLog(LogLevel::Error, msg.data());
+	}
+	return succeeded;
+}
+
+// returns number of stages which became ready
+DWORD StageGraph::finishStage(RunState& state, StageId stage, bool succeeded)
+{
+	DWORD newlyReady = 0;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		Stage& finishedStage = m_stages[stage];
+		finishedStage.status = succeeded ? StageStatus::Succeeded : StageStatus::Failed;
+		state.finishedCount++;
+
+		if (succeeded)
+		{
+			for (StageId dependent : finishedStage.dependents)
+			{
+				//skipped stage is already finished
+				if (--m_stages[dependent].pendingDependencies == 0 && m_stages[dependent].status == StageStatus::Pending)
+				{
+					state.readyStages.insert(dependent);
+					newlyReady++;
+				}
+			}
+		}
+		else
+		{
+			state.finishedCount += skipDependents(stage);
+		}
+	}
+	state.stageFinished.notify_all();
+	return newlyReady;
+}
+
+// marks all stages which depend (also indirectly) on the failed one. Returns number of newly skipped stages
+DWORD StageGraph::skipDependents(StageId stage)
+{
+	DWORD skippedCount = 0;
+	for (StageId dependent : m_stages[stage].dependents)
+	{
+		Stage& dependentStage = m_stages[dependent];
+		if (dependentStage.status != StageStatus::Pending)
+		{
+			continue;
+		}
+
+		dependentStage.status = StageStatus::Skipped;
+		std::string msg = "Skipped " + dependentStage.name + ", because a stage it depends on failed";
+		LogHelper::PrintLog(LogLevel::Warning, msg.data());
+		skippedCount += 1 + skipDependents(dependent);
+	}
+	return skippedCount;
+}
+
+//late helper finds no ready stage, so it doesn't touch the graph which can be already destroyed
+void StageGraph::submitHelpers(const std::shared_ptr<RunState>& state, DWORD count, ThreadPool* threadPool)
+{
+	if (!threadPool)
+	{
+		return;
+	}
+
+	for (DWORD i = 0; i < count; i++)
+	{
+		threadPool->submit([this, state, threadPool]()
+		{
+			StageId stage = 0;
+			if (takeReadyStage(*state, stage))
+			{
+				runStage(state, stage, threadPool);
+			}
+		});
+	}
+}
+
+bool StageGraph::takeReadyStage(RunState& state, StageId& stage)
+{
+	std::lock_guard<std::mutex> lock(state.mutex);
+	if (state.readyStages.empty())
+	{
+		return false;
+	}
+	stage = *state.readyStages.begin();
+	state.readyStages.erase(state.readyStages.begin());
+	return true;
+}
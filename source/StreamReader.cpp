@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "StreamReader.h"
+#include "LogHelper.h"
+
+StreamReader::StreamReader()
+{
+
+}
+
+void StreamReader::init(const ByteSource* input, const SectorLocator& locator, const DWORD* sectionInfoArray, 
+	DWORD sectionArraySize, DWORD firstSector, QWORD streamSize)
+{
+	m_input = input;
+	m_locator = locator;
+
+	m_streamSize = streamSize;
+	m_position = 0;
+	m_walker.init(sectionInfoArray, sectionArraySize, firstSector);
+	m_currentSector = firstSector;
+	m_currentSectorOffset = 0;
+	m_offsetInSector = 0;
+	m_failed = false;
+
+	if (m_streamSize > 0)
+	{
+		nextSector();
+	}
+}
+
+// returns number of read bytes. Less than "size" means end of stream or error (check good())
+QWORD StreamReader::read(BYTE* buffer, QWORD size)
+{
+	const QWORD positionBefore = m_position;
+	advance((std::min)(size, m_streamSize - m_position), buffer);
+	return m_position - positionBefore;
+}
+
+bool StreamReader::skip(QWORD size)
+{
+	if (size > m_streamSize - m_position)
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "StreamReader - skip behind the end of stream");
+		return false;
+	}
+	return advance(size, nullptr);
+}
+
+/*	Moves forward by "size" bytes and copies them to the buffer (if buffer isn't nullptr).
+	Physically consecutive sectors are merged, so they are copied at once.
+*/
+bool StreamReader::advance(QWORD size, BYTE* buffer)
+{
+	const DWORD sectionSize = m_locator.sectionSize();
+	while (size > 0 && !m_failed)
+	{
+		const QWORD spanOffset = m_currentSectorOffset + m_offsetInSector;
+		QWORD spanSize = 0;
+		bool contiguous = true;
+		while (spanSize < size && contiguous)
+		{
+			const QWORD bytesToTake = (std::min)(static_cast<QWORD>(sectionSize - m_offsetInSector), size - spanSize);
+			spanSize += bytesToTake;
+			m_offsetInSector += static_cast<DWORD>(bytesToTake);
+
+			//move to the next sector only if stream doesn't end here
+			if (m_offsetInSector == sectionSize && m_position + spanSize < m_streamSize)
+			{
+				const QWORD previousSectorOffset = m_currentSectorOffset;
+				if (!nextSector())
+				{
+					break;
+				}
+				contiguous = m_currentSectorOffset == previousSectorOffset + sectionSize;
+			}
+		}
+
+		if (m_failed)
+		{
+			break;
+		}
+
+		if (spanOffset > m_input->size() || m_input->size() - spanOffset < spanSize 
+			|| (buffer && !m_input->read(spanOffset, buffer, spanSize)))
+		{
+			std::string msg = "StreamReader - read out of bound. Offset: " + std::to_string(spanOffset);
+			LogHelper::PrintLog(LogLevel::Error, msg.data());
+			m_failed = true;
+			break;
+		}
+
+		if (buffer)
+		{
+			buffer += spanSize;
+		}
+
+		m_position += spanSize;
+		size -= spanSize;
+	}
+
+	return !m_failed;
+}
+
+// sectors are taken from ChainWalker, so loops in the chain are detected. Locator gives their place in the file
+bool StreamReader::nextSector()
+{
+	if (!m_walker.next(m_currentSector))
+	{
+		if (m_walker.error() == ChainError::None)
+		{
+			LogHelper::PrintLog(LogLevel::Error, "StreamReader - chain is shorter than stream");
+		}
+		m_walker.logError("StreamReader");
+		m_failed = true;
+		return false;
+	}
+
+	if (!m_locator.getOffset(m_currentSector, m_currentSectorOffset))
+	{
+		LogHelper::PrintLog(LogLevel::Error, "StreamReader - sector is behind the end of mini stream: ", m_currentSector);
+		m_failed = true;
+		return false;
+	}
+
+	m_offsetInSector = 0;
+	return true;
+}
+
+QWORD StreamReader::size() const
+{
+	return m_streamSize;
+}
+
+QWORD StreamReader::position() const
+{
+	return m_position;
+}
+
+bool StreamReader::eof() const
+{
+	return m_position >= m_streamSize;
+}
+
+bool StreamReader::good() const
+{
+	return !m_failed;
+}
@@ -0,0 +1,199 @@
+#include <cstring>
+
+#include "StringPool.h"
+#include "LogHelper.h"
+
+/*	Each entry of "!_StringPool" is a DWORD: WORD length and WORD occurance number. Not used entries have
+	occurance number 0. First entry is a header (codepage and the flag of 3 byte string references), so string 0
+	is always empty. Strings longer than MAX_WORD have length 0 and real length in the next DWORD.
+	Strings are stored one after another in "!_StringData", so offset of each string is a prefix sum of lengths.
+
+	Pool is built in two passes over chunks of entries:
+	1. each chunk counts its strings and bytes (in parallel),
+	2. prefix sums of chunk totals give the first offset and index of each chunk, then chunks write
+		offsets of their strings (in parallel).
+	Only the long string split between two chunks creates dependency. Such chunk is counted again
+	sequentially between passes, which is rare and cheap.
+*/
+bool StringPool::build(StreamBuffer&& stringData, const StreamBuffer& stringPool, ThreadPool* threadPool)
+{
+	clear();
+	if (stringData.size() > 0xFFFFFFFF)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "StringPool - string data is too big");
+		return false;
+	}
+
+	const DWORD poolEntriesCount = static_cast<DWORD>(stringPool.size() / sizeof(DWORD));
+	const DWORD* poolEntries = (const DWORD*)stringPool.data();
+	if (poolEntriesCount == 0)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "StringPool - header is missing");
+		return false;
+	}
+
+	//header isn't a string. With the flag set it would look like a string with garbage length
+	m_codepage = poolEntries[0] & ~Long_String_Refs_Flag;
+	m_stringRefSize = (poolEntries[0] & Long_String_Refs_Flag) ? 3 : sizeof(WORD);
+
+	std::vector<PoolChunk> chunks;
+	for (DWORD begin = 1; begin < poolEntriesCount; begin += (std::min)(Entries_In_Chunk, poolEntriesCount - begin))
+	{
+		chunks.push_back({ begin, begin + (std::min)(Entries_In_Chunk, poolEntriesCount - begin), false, false, 0, 0, 0, 0 });
+	}
+
+	//1. count strings and bytes in each chunk
+	auto countChunk = [&chunks, poolEntries](QWORD i) { scanChunk(poolEntries, chunks[static_cast<size_t>(i)], nullptr); };
+	if (threadPool && chunks.size() > 1)
+	{
+		threadPool->parallelFor(chunks.size(), countChunk);
+	}
+	else
+	{
+		for (QWORD i = 0; i < chunks.size(); i++)
+		{
+			countChunk(i);
+		}
+	}
+
+	//prefix sums. Chunks which start with the length of long string are counted again. String 0 is the header
+	QWORD dataOffset = 0;
+	DWORD stringIndex = 1;
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		if (i > 0 && chunks[i - 1].endsWithMarker)
+		{
+			chunks[i].startsWithLength = true;
+			scanChunk(poolEntries, chunks[i], nullptr);
+		}
+
+		chunks[i].firstDataOffset = dataOffset;
+		chunks[i].firstStringIndex = stringIndex;
+		dataOffset += chunks[i].dataSize;
+		stringIndex += chunks[i].stringCount;
+	}
+
+	if (!chunks.empty() && chunks.back().endsWithMarker)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "StringPool - long string length is missing");
+		return false;
+	}
+
+	if (dataOffset > stringData.size())
+	{
+		LogHelper::PrintLog(LogLevel::Error, "StringPool - strings are out of string data");
+		return false;
+	}
+
+	//2. write offsets. If longStrings occur then we allocate a bit too much, but unused indices are just empty strings
+	m_offsets.resize(static_cast<size_t>(poolEntriesCount) + 1);
+	m_offsets[0] = 0;
+	DWORD* offsets = m_offsets.data();
+	auto writeChunk = [&chunks, poolEntries, offsets](QWORD i) { scanChunk(poolEntries, chunks[static_cast<size_t>(i)], offsets); };
+	if (threadPool && chunks.size() > 1)
+	{
+		threadPool->parallelFor(chunks.size(), writeChunk);
+	}
+	else
+	{
+		for (QWORD i = 0; i < chunks.size(); i++)
+		{
+			writeChunk(i);
+		}
+	}
+
+	//rest of indices are empty strings placed at the end
+	for (size_t i = stringIndex; i < m_offsets.size(); i++)
+	{
+		m_offsets[i] = static_cast<DWORD>(dataOffset);
+	}
+
+	m_stringData = std::move(stringData);
+	return true;
+}
+
+void StringPool::clear()
+{
+	m_stringData.reset();
+	m_offsets.clear();
+	m_codepage = 0;
+	m_stringRefSize = sizeof(WORD);
+}
+
+DWORD StringPool::size() const
+{
+	return m_offsets.empty() ? 0 : static_cast<DWORD>(m_offsets.size() - 1);
+}
+
+// returns empty string for index out of bound
+std::string_view StringPool::get(DWORD index) const
+{
+	if (index >= size())
+	{
+		return std::string_view();
+	}
+
+	const char* strings = (const char*)m_stringData.data();
+	return std::string_view(strings + m_offsets[index], m_offsets[index + 1] - m_offsets[index]);
+}
+
+DWORD StringPool::codepage() const
+{
+	return m_codepage;
+}
+
+// size of string index in tables: 2 bytes, or 3 bytes if the pool has more strings than MAX_WORD
+DWORD StringPool::stringRefSize() const
+{
+	return m_stringRefSize;
+}
+
+// reads string index of size stringRefSize() from the table field
+DWORD StringPool::readStringRef(const BYTE* field) const
+{
+	DWORD stringIndex = 0;
+	::memcpy(&stringIndex, field, m_stringRefSize);
+	return stringIndex;
+}
+
+/*	Walks entries of one chunk. If "offsets" is nullptr only totals of chunk are counted,
+	otherwise offsets of strings are written (then prefix sums of chunk must be known).
+*/
+void StringPool::scanChunk(const DWORD* poolEntries, PoolChunk& chunk, DWORD* offsets)
+{
+	QWORD dataSize = 0;
+	DWORD stringCount = 0;
+	bool nextIsLength = chunk.startsWithLength;
+
+	for (DWORD i = chunk.beginEntry; i < chunk.endEntry; i++)
+	{
+		if (nextIsLength)
+		{
+			//there is long string
+			dataSize += poolEntries[i];
+			nextIsLength = false;
+			continue;
+		}
+
+		const WORD stringLength = static_cast<WORD>(poolEntries[i]);
+		const WORD occuranceNumber = static_cast<WORD>(poolEntries[i] >> 16);
+		if (offsets)
+		{
+			offsets[chunk.firstStringIndex + stringCount] = static_cast<DWORD>(chunk.firstDataOffset + dataSize);
+		}
+		stringCount++;
+
+		if (occuranceNumber > 0)
+		{
+			if (stringLength == 0)
+			{
+				nextIsLength = true;
+			}
+			dataSize += stringLength;
+		}
+	}
+
+	chunk.dataSize = dataSize;
+	chunk.stringCount = stringCount;
+	chunk.endsWithMarker = nextIsLength;
+}
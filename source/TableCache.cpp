@@ -0,0 +1,95 @@
+#include "TableCache.h"
+
+// capacity is given in bytes. 0 disables the cache. Tables over the new budget are evicted
+void TableCache::setCapacity(QWORD capacity)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_capacity = capacity;
+	evictOverBudget();
+}
+
+// returns nullptr if table isn't cached
+std::shared_ptr<const MsiTable> TableCache::find(const std::string& tableName) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto found = m_entryMap.find(tableName);
+	if (found == m_entryMap.end())
+	{
+		m_misses++;
+		return nullptr;
+	}
+
+	m_entries.splice(m_entries.begin(), m_entries, found->second);
+	m_hits++;
+	return found->second->table;
+}
+
+/*	Returns the cached table. If other thread decoded the same table in the meantime, its table is kept
+	and returned, so every stage sees the same instance.
+*/
+std::shared_ptr<const MsiTable> TableCache::insert(const std::string& tableName, std::shared_ptr<const MsiTable> table)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto found = m_entryMap.find(tableName);
+	if (found != m_entryMap.end())
+	{
+		return found->second->table;
+	}
+
+	const QWORD memoryUsage = table->memoryUsage();
+	if (memoryUsage > m_capacity)
+	{
+		return table;
+	}
+
+	m_entries.push_front({ tableName, table, memoryUsage });
+	m_entryMap[tableName] = m_entries.begin();
+	m_memoryUsage += memoryUsage;
+	evictOverBudget();
+	return table;
+}
+
+void TableCache::evict(const std::string& tableName)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto found = m_entryMap.find(tableName);
+	if (found == m_entryMap.end())
+	{
+		return;
+	}
+
+	m_memoryUsage -= found->second->memoryUsage;
+	m_entries.erase(found->second);
+	m_entryMap.erase(found);
+	m_evicted++;
+}
+
+void TableCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_evicted += m_entries.size();
+	m_entries.clear();
+	m_entryMap.clear();
+	m_memoryUsage = 0;
+}
+
+TableCacheStats TableCache::getStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return { m_hits, m_misses, m_evicted, m_memoryUsage };
+}
+
+// must be called under the lock. The least recently used tables are dropped first
+void TableCache::evictOverBudget()
+{
+	while (m_memoryUsage > m_capacity && !m_entries.empty())
+	{
+		m_memoryUsage -= m_entries.back().memoryUsage;
+		m_entryMap.erase(m_entries.back().name);
+		m_entries.pop_back();
+		m_evicted++;
+	}
+}
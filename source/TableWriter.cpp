@@ -0,0 +1,495 @@
+#ifdef _WIN32
+#include <windows.h>
+#include <climits>
+#else
+#include <iconv.h>
+#endif
+
+#include <charconv>
+#include <algorithm>
+#include <cstring>
+
+#include "TableWriter.h"
+#include "LogHelper.h"
+
+//enough for DWORD in any base and a few chars around it
+static constexpr size_t Max_Number_Size = 16;
+
+TableWriter::TableWriter()
+{
+
+}
+
+TableWriter::~TableWriter()
+{
+	if (m_output)
+	{
+		close();
+	}
+}
+
+bool TableWriter::open(OutputSink& sink, const std::string& path, TableFormat format, const std::vector<ColumnInfo>& columns,
+	DWORD codepage, DWORD bufferSize)
+{
+	//table is written in binary mode, so line endings are the same on each platform
+	if (!sink.openFile(path, m_output))
+	{
+		std::string msg = "Cannot open \"" + path + "\" file";
+		LogHelper::PrintLog(LogLevel::Error, msg.data());
+		return false;
+	}
+
+	m_buffer.resize((std::max)(static_cast<size_t>(bufferSize), Max_Number_Size));
+	m_used = 0;
+	m_failed = false;
+	m_format = format;
+	m_columns = &columns;
+	m_rowIndex = 0;
+	m_columnIndex = 0;
+	m_codepage = codepage;
+
+	//codepage 0 is neutral, so its strings should be ascii
+	if (m_format == TableFormat::JsonLines && m_codepage != 0 && !openConverter())
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "TableWriter - codepage isn't supported, non-ascii chars are escaped: ", m_codepage);
+	}
+
+	writeHeader();
+	return true;
+}
+
+bool TableWriter::close()
+{
+	flush();
+	if (!m_output->close())
+	{
+		m_failed = true;
+	}
+	m_output.reset();
+	m_buffer.clear();
+	m_buffer.shrink_to_fit();
+	closeConverter();
+
+	if (m_failed)
+	{
+		LogHelper::PrintLog(LogLevel::Error, "TableWriter - cannot write the table");
+	}
+	return !m_failed;
+}
+
+void TableWriter::writeHeader()
+{
+	const std::vector<ColumnInfo>& columns = *m_columns;
+	switch (m_format)
+	{
+	case TableFormat::Text:
+		append("\t|\t");
+		for (const ColumnInfo& column : columns)
+		{
+			append(column.name);
+			append(" \t|\t");
+		}
+		append("\r\n");
+		break;
+	case TableFormat::Csv:
+	case TableFormat::Tsv:
+		for (DWORD i = 0; i < columns.size(); i++)
+		{
+			if (i != 0)
+			{
+				append(m_format == TableFormat::Csv ? ',' : '\t');
+			}
+			writeEscaped(columns[i].name);
+		}
+		append(m_format == TableFormat::Csv ? "\r\n" : "\n");
+		break;
+	case TableFormat::JsonLines:
+		//each row has column names as keys
+		break;
+	}
+}
+
+void TableWriter::beginRow()
+{
+	m_rowIndex++;
+	m_columnIndex = 0;
+	switch (m_format)
+	{
+	case TableFormat::Text:
+		writeInteger(static_cast<DWORD>(m_rowIndex), 10);
+		append(".\t");
+		break;
+	case TableFormat::JsonLines:
+		append('{');
+		break;
+	default:
+		break;
+	}
+}
+
+void TableWriter::endRow()
+{
+	switch (m_format)
+	{
+	case TableFormat::Text:
+	case TableFormat::Csv:
+		append("\r\n");
+		break;
+	case TableFormat::Tsv:
+		append('\n');
+		break;
+	case TableFormat::JsonLines:
+		append("}\n");
+		break;
+	}
+}
+
+//separator before the cell (and key for json)
+void TableWriter::beginCell()
+{
+	if (m_columnIndex != 0)
+	{
+		switch (m_format)
+		{
+		case TableFormat::Text:
+			append(" \t|\t ");
+			break;
+		case TableFormat::Csv:
+		case TableFormat::JsonLines:
+			append(',');
+			break;
+		case TableFormat::Tsv:
+			append('\t');
+			break;
+		}
+	}
+
+	if (m_format == TableFormat::JsonLines)
+	{
+		const std::vector<ColumnInfo>& columns = *m_columns;
+		if (m_columnIndex < columns.size())
+		{
+			writeEscaped(columns[m_columnIndex].name);
+		}
+		else
+		{
+			writeEscaped("");
+		}
+		append(':');
+	}
+	m_columnIndex++;
+}
+
+void TableWriter::writeString(std::string_view value)
+{
+	beginCell();
+	if (m_format == TableFormat::Text)
+	{
+		append(value);
+	}
+	else
+	{
+		writeEscaped(value);
+	}
+}
+
+void TableWriter::writeNumber(DWORD value)
+{
+	beginCell();
+	writeInteger(value, 10);
+}
+
+//value of unknown type. Text format prints it in hex, other formats as a regular number
+void TableWriter::writeBinary(DWORD value)
+{
+	beginCell();
+	writeInteger(value, m_format == TableFormat::Text ? 16 : 10);
+}
+
+/*	Quoting of a string value (or a column name) depends on format:
+	- csv: value is quoted only if it has ',', '"' or a newline. '"' is doubled,
+	- tsv: tab, newlines and '\' are written as "\t", "\n", "\r" and "\\",
+	- json: value is always quoted, '"', '\' and control chars are escaped. Strings are converted from the msi
+	  codepage to utf-8. If it's not possible, bytes above 0x7f are escaped as "\u00XX" (so output stays valid utf-8).
+	Runs of chars which don't need escaping are copied at once.
+*/
+void TableWriter::writeEscaped(std::string_view value)
+{
+	switch (m_format)
+	{
+	case TableFormat::Text:
+		append(value);
+		break;
+	case TableFormat::Csv:
+	{
+		if (value.find_first_of(",\"\r\n") == std::string_view::npos)
+		{
+			append(value);
+			break;
+		}
+
+		append('"');
+		size_t runBegin = 0;
+		for (size_t quote = value.find('"'); quote != std::string_view::npos; quote = value.find('"', quote + 1))
+		{
+			append(value.substr(runBegin, quote + 1 - runBegin));
+			append('"');
+			runBegin = quote + 1;
+		}
+		append(value.substr(runBegin));
+		append('"');
+		break;
+	}
+	case TableFormat::Tsv:
+	case TableFormat::JsonLines:
+	{
+		const bool isJson = m_format == TableFormat::JsonLines;
+		bool escapeNonAscii = false;
+		if (isJson)
+		{
+			append('"');
+
+			const bool isAscii = std::all_of(value.begin(), value.end(), [](char c) { return static_cast<BYTE>(c) < 0x80; });
+			if (!isAscii)
+			{
+				if (transcode(value, m_transcoded))
+				{
+					value = m_transcoded;
+				}
+				else
+				{
+					escapeNonAscii = true;
+				}
+			}
+		}
+
+		size_t runBegin = 0;
+		for (size_t i = 0; i < value.size(); i++)
+		{
+			const BYTE c = static_cast<BYTE>(value[i]);
+			const bool needsEscape = c == '\\' || (isJson ? (c == '"' || c < 0x20 || (escapeNonAscii && c > 0x7f)) : (c == '\t' || c == '\n' || c == '\r'));
+			if (!needsEscape)
+			{
+				continue;
+			}
+
+			append(value.substr(runBegin, i - runBegin));
+			runBegin = i + 1;
+			switch (c)
+			{
+			case '\\':
+				append("\\\\");
+				break;
+			case '"':
+				append("\\\"");
+				break;
+			case '\t':
+				append("\\t");
+				break;
+			case '\n':
+				append("\\n");
+				break;
+			case '\r':
+				append("\\r");
+				break;
+			default:
+			{
+				const char Hex_Digits[] = "0123456789abcdef";
+				const char escaped[] = { '\\', 'u', '0', '0', Hex_Digits[c >> 4], Hex_Digits[c & 0xf] };
+				append(std::string_view(escaped, sizeof(escaped)));
+				break;
+			}
+			}
+		}
+		append(value.substr(runBegin));
+
+		if (isJson)
+		{
+			append('"');
+		}
+		break;
+	}
+	}
+}
+
+#ifdef _WIN32
+bool TableWriter::openConverter()
+{
+	return ::IsValidCodePage(m_codepage) != FALSE;
+}
+
+void TableWriter::closeConverter()
+{
+
+}
+
+// returns false if value isn't valid in the codepage
+bool TableWriter::transcode(std::string_view value, std::string& output)
+{
+	if (m_codepage == 0 || value.size() > static_cast<size_t>(INT_MAX / 3))
+	{
+		return false;
+	}
+
+	const int inputSize = static_cast<int>(value.size());
+	//one input byte is at most one utf-16 unit
+	std::wstring wide(value.size(), L'\0');
+	const int wideSize = ::MultiByteToWideChar(m_codepage, MB_ERR_INVALID_CHARS, value.data(), inputSize, wide.data(), inputSize);
+	if (wideSize <= 0)
+	{
+		return false;
+	}
+
+	//one utf-16 unit is at most 3 bytes of utf-8
+	output.resize(static_cast<size_t>(wideSize) * 3);
+	const int outputSize = ::WideCharToMultiByte(CP_UTF8, 0, wide.data(), wideSize, output.data(), static_cast<int>(output.size()), nullptr, nullptr);
+	if (outputSize <= 0)
+	{
+		return false;
+	}
+	output.resize(outputSize);
+	return true;
+}
+#else
+// iconv knows windows codepages as "CPnnnn"
+bool TableWriter::openConverter()
+{
+	closeConverter();
+	const std::string codepageName = m_codepage == 65001 ? "UTF-8" : "CP" + std::to_string(m_codepage);
+	iconv_t converter = ::iconv_open("UTF-8", codepageName.c_str());
+	if (converter == reinterpret_cast<iconv_t>(-1))
+	{
+		return false;
+	}
+
+	m_converter = converter;
+	return true;
+}
+
+void TableWriter::closeConverter()
+{
+	if (m_converter)
+	{
+		::iconv_close(static_cast<iconv_t>(m_converter));
+		m_converter = nullptr;
+	}
+}
+
+// returns false if value isn't valid in the codepage
+bool TableWriter::transcode(std::string_view value, std::string& output)
+{
+	if (!m_converter)
+	{
+		return false;
+	}
+
+	iconv_t converter = static_cast<iconv_t>(m_converter);
+	::iconv(converter, nullptr, nullptr, nullptr, nullptr);
+
+	//one input byte is at most 3 bytes of utf-8, multi byte chars give less per byte
+	output.resize(value.size() * 4);
+	char* input = const_cast<char*>(value.data());
+	size_t inputLeft = value.size();
+	char* result = output.data();
+	size_t resultLeft = output.size();
+	if (::iconv(converter, &input, &inputLeft, &result, &resultLeft) == static_cast<size_t>(-1) ||
+		::iconv(converter, nullptr, nullptr, &result, &resultLeft) == static_cast<size_t>(-1))
+	{
+		return false;
+	}
+	output.resize(output.size() - resultLeft);
+	return true;
+}
+#endif
+
+void TableWriter::writeInteger(DWORD value, int base)
+{
+	char* output = reserve(Max_Number_Size);
+	const std::to_chars_result result = std::to_chars(output, output + Max_Number_Size, value, base);
+	m_used += result.ptr - output;
+}
+
+void TableWriter::append(std::string_view text)
+{
+	while (!text.empty())
+	{
+		if (m_used == m_buffer.size())
+		{
+			flush();
+		}
+
+		const size_t bytesToCopy = (std::min)(text.size(), m_buffer.size() - m_used);
+		std::memcpy(m_buffer.data() + m_used, text.data(), bytesToCopy);
+		m_used += bytesToCopy;
+		text.remove_prefix(bytesToCopy);
+	}
+}
+
+void TableWriter::append(char c)
+{
+	*reserve(1) = c;
+	m_used++;
+}
+
+// returns place for at least "size" bytes. Buffer is flushed if there isn't enough space
+char* TableWriter::reserve(size_t size)
+{
+	if (m_buffer.size() - m_used < size)
+	{
+		flush();
+	}
+	return m_buffer.data() + m_used;
+}
+
+void TableWriter::flush()
+{
+	if (m_used > 0 && !m_failed)
+	{
+		if (!m_output->write(m_buffer.data(), m_used))
+		{
+			m_failed = true;
+		}
+	}
+	m_used = 0;
+}
+
+bool TableWriter::parseFormat(std::string_view name, TableFormat& format)
+{
+	if (name.compare("text") == 0)
+	{
+		format = TableFormat::Text;
+	}
+	else if (name.compare("csv") == 0)
+	{
+		format = TableFormat::Csv;
+	}
+	else if (name.compare("tsv") == 0)
+	{
+		format = TableFormat::Tsv;
+	}
+	else if (name.compare("jsonl") == 0)
+	{
+		format = TableFormat::JsonLines;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+//text tables are saved without extension, like in previous versions
+const char* TableWriter::fileExtension(TableFormat format)
+{
+	switch (format)
+	{
+	case TableFormat::Csv:
+		return ".csv";
+	case TableFormat::Tsv:
+		return ".tsv";
+	case TableFormat::JsonLines:
+		return ".jsonl";
+	default:
+		return "";
+	}
+}
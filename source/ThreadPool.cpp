@@ -0,0 +1,118 @@
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+// 0 means one thread per hardware thread
+ThreadPool::ThreadPool(DWORD threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+		if (threadCount == 0)
+		{
+			threadCount = 1;
+		}
+	}
+
+	for (DWORD i = 0; i < threadCount; i++)
+	{
+		m_threads.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_taskReady.notify_all();
+
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_taskReady.notify_one();
+}
+
+/*	Calls body(i) for each i in [0, count). Indices are taken one by one from the shared counter, so caller should
+	make one index a reasonable chunk of work. Returns when all indices are done.
+*/
+void ThreadPool::parallelFor(QWORD count, const std::function<void(QWORD index)>& body)
+{
+	struct SharedState
+	{
+		std::atomic<QWORD> nextIndex{ 0 };
+		QWORD doneCount = 0;
+		std::mutex mutex;
+		std::condition_variable allDone;
+	};
+
+	//helpers can start after parallelFor returned, so the state is shared
+	std::shared_ptr<SharedState> state = std::make_shared<SharedState>();
+	auto work = [state, count, &body]()
+	{
+		QWORD doneByThisThread = 0;
+		for (QWORD index = state->nextIndex++; index < count; index = state->nextIndex++)
+		{
+			body(index);
+			doneByThisThread++;
+		}
+
+		if (doneByThisThread > 0)
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->doneCount += doneByThisThread;
+			if (state->doneCount == count)
+			{
+				state->allDone.notify_all();
+			}
+		}
+	};
+
+	const QWORD helpersCount = (std::min)(static_cast<QWORD>(m_threads.size()), count > 0 ? count - 1 : 0);
+	for (QWORD i = 0; i < helpersCount; i++)
+	{
+		//late helper finds no index, so it doesn't touch "body" which can be already destroyed
+		submit(work);
+	}
+	work();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->allDone.wait(lock, [&state, count]() { return state->doneCount == count; });
+}
+
+DWORD ThreadPool::threadCount() const
+{
+	return static_cast<DWORD>(m_threads.size());
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_taskReady.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+			if (m_tasks.empty())
+			{
+				//stopping and nothing left
+				return;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,166 @@
+#include <cstring>
+
+#include "UnpackKernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define UNPACK_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(UNPACK_X86) && !defined(_MSC_VER)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define TARGET_AVX2
+#define TARGET_SSE2
+#endif
+
+static void unpackWordsScalar(const BYTE* input, DWORD count, DWORD* output)
+{
+	for (DWORD i = 0; i < count; i++)
+	{
+		WORD value = 0;
+		::memcpy(&value, input + i * sizeof(WORD), sizeof(WORD));
+		output[i] = value;
+	}
+}
+
+static void unpackThreeBytesScalar(const BYTE* input, DWORD count, DWORD* output)
+{
+	for (DWORD i = 0; i < count; i++)
+	{
+		const BYTE* field = input + i * 3;
+		output[i] = field[0] | (field[1] << 8) | (field[2] << 16);
+	}
+}
+
+#ifdef UNPACK_X86
+// 8 WORD's per step. High halves are filled with zeros by interleaving with zero register
+TARGET_SSE2 static void unpackWordsSse2(const BYTE* input, DWORD count, DWORD* output)
+{
+	const __m128i zero = _mm_setzero_si128();
+	DWORD i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i * sizeof(WORD)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_unpacklo_epi16(words, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 4), _mm_unpackhi_epi16(words, zero));
+	}
+	unpackWordsScalar(input + i * sizeof(WORD), count - i, output + i);
+}
+
+// 16 WORD's per step
+TARGET_AVX2 static void unpackWordsAvx2(const BYTE* input, DWORD count, DWORD* output)
+{
+	DWORD i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i * sizeof(WORD)));
+		const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + (i + 8) * sizeof(WORD)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_cvtepu16_epi32(low));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i + 8), _mm256_cvtepu16_epi32(high));
+	}
+	unpackWordsScalar(input + i * sizeof(WORD), count - i, output + i);
+}
+
+// AVX2 needs also support from the system (saved ymm registers), not only from the cpu
+static bool cpuSupportsAvx2()
+{
+#ifdef _MSC_VER
+	int info[4] = { 0 };
+	__cpuid(info, 0);
+	if (info[0] < 7)
+	{
+		return false;
+	}
+
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool cpuSupportsSse2()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+	return true;
+#elif defined(_MSC_VER)
+	int info[4] = { 0 };
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+#endif
+
+static UnpackKernel selectUnpackKernel()
+{
+#ifdef UNPACK_X86
+	if (cpuSupportsAvx2())
+	{
+		return UnpackKernel::Avx2;
+	}
+	if (cpuSupportsSse2())
+	{
+		return UnpackKernel::Sse2;
+	}
+#endif
+	return UnpackKernel::Scalar;
+}
+
+// cpu is checked once
+UnpackKernel getUnpackKernel()
+{
+	static const UnpackKernel kernel = selectUnpackKernel();
+	return kernel;
+}
+
+void unpackFields(const BYTE* input, DWORD fieldSize, DWORD count, DWORD* output)
+{
+	unpackFields(getUnpackKernel(), input, fieldSize, count, output);
+}
+
+void unpackFields(UnpackKernel kernel, const BYTE* input, DWORD fieldSize, DWORD count, DWORD* output)
+{
+	switch (fieldSize)
+	{
+	case sizeof(WORD):
+		switch (kernel)
+		{
+#ifdef UNPACK_X86
+		case UnpackKernel::Avx2:
+			unpackWordsAvx2(input, count, output);
+			return;
+		case UnpackKernel::Sse2:
+			unpackWordsSse2(input, count, output);
+			return;
+#endif
+		default:
+			unpackWordsScalar(input, count, output);
+			return;
+		}
+	case 3:
+		unpackThreeBytesScalar(input, count, output);
+		return;
+	case sizeof(DWORD):
+		//already DWORD's, only alignment can be different
+		::memcpy(output, input, static_cast<size_t>(count) * sizeof(DWORD));
+		return;
+	default:
+		::memset(output, 0, static_cast<size_t>(count) * sizeof(DWORD));
+		return;
+	}
+}
@@ -0,0 +1,171 @@
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "MsiTable.h"
+#include "UnpackKernels.h"
+
+/*	Microbenchmark of unpackFields (built with "make bench", it isn't part of MsiAnalyzer). Each kernel is compared
+	with the per-cell loop used by saveTable before (MsiTableColumn::get for every field). Before timing,
+	each kernel is checked against the per-cell result for every count up to Check_Max_Count and each
+	alignment of the input, so wrong kernel fails the benchmark.
+	Usage: UnpackKernelsBench.out [rows]
+*/
+
+static constexpr DWORD Default_Row_Count = 1024 * 1024;
+static constexpr DWORD Block_Rows = 256;		//the same as MsiTableParser::Unpack_Block_Rows
+static constexpr DWORD Check_Max_Count = 300;
+static constexpr DWORD Repeat_Count = 20;
+static const DWORD Field_Sizes[] = { sizeof(WORD), 3, sizeof(DWORD) };
+
+static const char* kernelName(UnpackKernel kernel)
+{
+	switch (kernel)
+	{
+	case UnpackKernel::Avx2:
+		return "avx2";
+	case UnpackKernel::Sse2:
+		return "sse2";
+	default:
+		return "scalar";
+	}
+}
+
+//kernels which can run on this cpu
+static std::vector<UnpackKernel> supportedKernels()
+{
+	std::vector<UnpackKernel> kernels = { UnpackKernel::Scalar };
+	if (getUnpackKernel() != UnpackKernel::Scalar)
+	{
+		kernels.push_back(UnpackKernel::Sse2);
+	}
+	if (getUnpackKernel() == UnpackKernel::Avx2)
+	{
+		kernels.push_back(UnpackKernel::Avx2);
+	}
+	return kernels;
+}
+
+// input has one spare byte in front, so unaligned fields are also tested
+static bool checkKernel(UnpackKernel kernel, DWORD fieldSize, const std::vector<BYTE>& data)
+{
+	std::vector<DWORD> output(Check_Max_Count + 1);
+	for (DWORD offset = 0; offset < 2; offset++)
+	{
+		const MsiTableColumn column(data.data() + offset, fieldSize, Check_Max_Count);
+		for (DWORD count = 0; count <= Check_Max_Count; count++)
+		{
+			//value behind the end must not be touched
+			output[count] = 0xdeadbeef;
+			unpackFields(kernel, column.data(), fieldSize, count, output.data());
+			for (DWORD row = 0; row < count; row++)
+			{
+				if (output[row] != column.get(row))
+				{
+					std::cerr << "Error: " << kernelName(kernel) << " kernel differs from the per-cell loop. Field size: " << fieldSize
+						<< ", count: " << count << ", row: " << row << ", offset: " << offset << std::endl;
+					return false;
+				}
+			}
+			if (output[count] != 0xdeadbeef)
+			{
+				std::cerr << "Error: " << kernelName(kernel) << " kernel writes behind the output. Field size: " << fieldSize
+					<< ", count: " << count << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// returns the best time of Repeat_Count runs in milliseconds. Checksum keeps the compiler from dropping the work
+template<typename Action>
+static double measure(Action action, const std::vector<DWORD>& output, QWORD& checksum)
+{
+	double bestTime = 0;
+	for (DWORD i = 0; i < Repeat_Count; i++)
+	{
+		const auto startTime = std::chrono::steady_clock::now();
+		action();
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+		if (i == 0 || elapsed.count() < bestTime)
+		{
+			bestTime = elapsed.count();
+		}
+		checksum += output[i % output.size()];
+	}
+	return bestTime;
+}
+
+int main(int argc, char* argv[])
+{
+	DWORD rowCount = Default_Row_Count;
+	if (argc > 1)
+	{
+		rowCount = static_cast<DWORD>(std::strtoul(argv[1], nullptr, 10));
+	}
+	if (rowCount < Check_Max_Count)
+	{
+		rowCount = Check_Max_Count;
+	}
+
+	std::mt19937 random(1);
+	std::vector<BYTE> data(static_cast<size_t>(rowCount) * sizeof(DWORD) + 1);
+	for (BYTE& byte : data)
+	{
+		byte = static_cast<BYTE>(random());
+	}
+
+	const std::vector<UnpackKernel> kernels = supportedKernels();
+	for (DWORD fieldSize : Field_Sizes)
+	{
+		for (UnpackKernel kernel : kernels)
+		{
+			if (!checkKernel(kernel, fieldSize, data))
+			{
+				return 1;
+			}
+		}
+	}
+	std::cout << "All kernels match the per-cell loop (counts 0-" << Check_Max_Count << ", aligned and unaligned input)" << std::endl;
+	std::cout << "Rows: " << rowCount << ", best of " << Repeat_Count << " runs, blocks of " << Block_Rows << " rows" << std::endl;
+
+	QWORD checksum = 0;
+	std::vector<DWORD> output(rowCount);
+	std::cout << std::fixed << std::setprecision(3);
+	for (DWORD fieldSize : Field_Sizes)
+	{
+		const MsiTableColumn column(data.data(), fieldSize, rowCount);
+
+		//per-cell loop of the old saveTable
+		const double perCellTime = measure([&]()
+		{
+			for (DWORD row = 0; row < rowCount; row++)
+			{
+				output[row] = column.get(row);
+			}
+		}, output, checksum);
+		std::cout << "field size " << fieldSize << ": per-cell " << perCellTime << " ms" << std::endl;
+
+		for (UnpackKernel kernel : kernels)
+		{
+			const double kernelTime = measure([&]()
+			{
+				for (DWORD firstRow = 0; firstRow < rowCount; firstRow += Block_Rows)
+				{
+					const DWORD count = (std::min)(Block_Rows, rowCount - firstRow);
+					unpackFields(kernel, column.data() + static_cast<size_t>(firstRow) * fieldSize, fieldSize, count, output.data() + firstRow);
+				}
+			}, output, checksum);
+			std::cout << "field size " << fieldSize << ": " << kernelName(kernel) << " " << kernelTime << " ms ("
+				<< perCellTime / kernelTime << "x)" << std::endl;
+		}
+	}
+
+	std::cout << "Checksum: " << checksum << std::endl;
+	return 0;
+}
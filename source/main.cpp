@@ -1,12 +1,91 @@
 #include <vector>
-#include <fstream>
+#include <memory>
+#include <cstdlib>
+#include <sstream>
+#include <iostream>
 #include <filesystem>
 
 #include "CfbExtractor.h"
 #include "MsiTableParser.h"
 #include "LogHelper.h"
+#include "ByteSource.h"
+#include "MappedFile.h"
+#include "OutputSink.h"
+#include "StageGraph.h"
 
-int analyzeMsi(std::string szMsiPath, std::string outpuDir);
+//how the input msi is read
+enum class ReadMode
+{
+	Mmap,
+	Pread
+};
+
+//where the results are written
+enum class OutputMode
+{
+	Directory,
+	Tar,
+	Stdout		//tar stream, logs go to stderr
+};
+
+//options which can be given before positional arguments
+struct AnalyzeOptions
+{
+	DWORD ioBufferSize = 0;		//0 means default
+	QWORD inFlightLimit = MsiTableParser::Default_In_Flight_Limit;
+	ReadMode readMode = ReadMode::Mmap;
+	bool sectorCacheSizeSet = false;
+	QWORD sectorCacheSize = 0;
+	QWORD tableCacheSize = TableCache::Default_Capacity;
+	TableFormat tableFormat = TableFormat::Text;
+	DWORD jobs = 0;		//0 means one per hardware thread
+	OutputMode outputMode = OutputMode::Directory;
+};
+
+//msi path "-" means that msi is read from stdin (eg. piped from archive extractor)
+constexpr char Stdin_Path[] = "-";
+
+int analyzeMsi(std::string szMsiPath, OutputSink& output, const AnalyzeOptions& options);
+
+void printUsage()
+{
+	std::cout << "MsiAnalyzer.exe [options] <msi_file> or" << std::endl;
+	std::cout << "MsiAnalyzer.exe [options] <msi_file> <output_dir>" << std::endl;
+	std::cout << "MsiAnalyzer.exe [options] <msi_file> <output_tar>  (with --output-mode tar)" << std::endl;
+	std::cout << "options:" << std::endl;
+	std::cout << "  --buffer-size <bytes>  size of buffer used to copy embedded files (default 1 MB)" << std::endl;
+	std::cout << "  --max-in-flight <bytes>  limit of copy buffers of all threads together (default 64 MB)" << std::endl;
+	std::cout << "  --read-mode <mode>     how the msi file is read: mmap (default) or pread" << std::endl;
+	std::cout << "  --cache-size <bytes>   size of sector cache, 0 disables it (default 16 MB for pread and stdin, 0 for mmap)" << std::endl;
+	std::cout << "  --table-cache-size <bytes>  memory budget for parsed tables, 0 disables the cache (default 64 MB)" << std::endl;
+	std::cout << "  --table-format <format>     format of saved tables: text (default), csv, tsv or jsonl" << std::endl;
+	std::cout << "  --jobs <count>         number of threads, 1 means everything in the main thread (default one per hardware thread)" << std::endl;
+	std::cout << "  --output-mode <mode>   where results are written: dir (default), tar (one archive) or stdout (tar stream)" << std::endl;
+	std::cout << "  <msi_file> can be \"-\", then msi is read from stdin" << std::endl;
+}
+
+bool openInput(const std::string& msiPath, const AnalyzeOptions& options, std::unique_ptr<ByteSource>& input)
+{
+	if (msiPath.compare(Stdin_Path) == 0)
+	{
+		std::unique_ptr<SpooledByteSource> spooledInput(new SpooledByteSource());
+		ASSERT_BOOL(spooledInput->open(stdin));
+		input = std::move(spooledInput);
+	}
+	else if (options.readMode == ReadMode::Pread)
+	{
+		std::unique_ptr<FileByteSource> fileInput(new FileByteSource());
+		ASSERT_BOOL(fileInput->open(msiPath));
+		input = std::move(fileInput);
+	}
+	else
+	{
+		std::unique_ptr<MappedFile> mappedInput(new MappedFile());
+		ASSERT_BOOL(mappedInput->open(msiPath));
+		input = std::move(mappedInput);
+	}
+	return true;
+}
 
 int main(int argc, char* argv[])
 {
@@ -16,90 +95,255 @@ int main(int argc, char* argv[])
 
 	std::string msiFilePath;
 	std::string outpuDir = "output";
-	if (argc != 2 && argc != 3)
+	AnalyzeOptions options;
+	std::vector<std::string> positionalArgs;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg.compare("--buffer-size") == 0 && i + 1 < argc)
+		{
+			options.ioBufferSize = static_cast<DWORD>(std::strtoul(argv[++i], nullptr, 0));
+		}
+		else if (arg.compare("--max-in-flight") == 0 && i + 1 < argc)
+		{
+			options.inFlightLimit = std::strtoull(argv[++i], nullptr, 0);
+		}
+		else if (arg.compare("--cache-size") == 0 && i + 1 < argc)
+		{
+			options.sectorCacheSize = std::strtoull(argv[++i], nullptr, 0);
+			options.sectorCacheSizeSet = true;
+		}
+		else if (arg.compare("--table-cache-size") == 0 && i + 1 < argc)
+		{
+			options.tableCacheSize = std::strtoull(argv[++i], nullptr, 0);
+		}
+		else if (arg.compare("--jobs") == 0 && i + 1 < argc)
+		{
+			options.jobs = static_cast<DWORD>(std::strtoul(argv[++i], nullptr, 0));
+		}
+		else if (arg.compare("--table-format") == 0 && i + 1 < argc)
+		{
+			std::string format = argv[++i];
+			if (!TableWriter::parseFormat(format, options.tableFormat))
+			{
+				std::cout << "Unknown table format: " << format << std::endl;
+				printUsage();
+				return -1;
+			}
+		}
+		else if (arg.compare("--output-mode") == 0 && i + 1 < argc)
+		{
+			std::string mode = argv[++i];
+			if (mode.compare("dir") == 0)
+			{
+				options.outputMode = OutputMode::Directory;
+			}
+			else if (mode.compare("tar") == 0)
+			{
+				options.outputMode = OutputMode::Tar;
+			}
+			else if (mode.compare("stdout") == 0)
+			{
+				options.outputMode = OutputMode::Stdout;
+			}
+			else
+			{
+				std::cout << "Unknown output mode: " << mode << std::endl;
+				printUsage();
+				return -1;
+			}
+		}
+		else if (arg.compare("--read-mode") == 0 && i + 1 < argc)
+		{
+			std::string mode = argv[++i];
+			if (mode.compare("mmap") == 0)
+			{
+				options.readMode = ReadMode::Mmap;
+			}
+			else if (mode.compare("pread") == 0)
+			{
+				options.readMode = ReadMode::Pread;
+			}
+			else
+			{
+				std::cout << "Unknown read mode: " << mode << std::endl;
+				printUsage();
+				return -1;
+			}
+		}
+		else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0)
+		{
+			std::cout << "Unknown option: " << arg << std::endl;
+			printUsage();
+			return -1;
+		}
+		else
+		{
+			positionalArgs.push_back(arg);
+		}
+	}
+
+	//stdout has no output path
+	const size_t maxPositionalArgs = options.outputMode == OutputMode::Stdout ? 1 : 2;
+	if (positionalArgs.size() < 1 || positionalArgs.size() > maxPositionalArgs)
 	{
-		std::cout << "MsiAnalyzer.exe <msi_file> or" << std::endl;
-		std::cout << "MsiAnalyzer.exe <msi_file> <output_dir>" << std::endl;
+		printUsage();
 		return -1;
 	}
 
+	//in stdout mode only the archive can be written to stdout
+	std::ostream& console = options.outputMode == OutputMode::Stdout ? std::cerr : std::cout;
+
 	//get input msi
-	if (argc >= 2)
+	if (positionalArgs.size() >= 1)
 	{
-		msiFilePath = std::string(argv[1]);
+		msiFilePath = positionalArgs[0];
 
-		if (!std::filesystem::exists(msiFilePath))
+		if (msiFilePath.compare(Stdin_Path) != 0 && !std::filesystem::exists(msiFilePath))
 		{
-			std::cout << "Given msi file not exists" << std::endl;
+			console << "Given msi file not exists" << std::endl;
 			return -3;
 		}
 	}
 
-	//get output dir
-	if (argc == 2)
+	std::unique_ptr<OutputSink> output;
+	if (options.outputMode == OutputMode::Directory)
 	{
-		std::cout << "Default output directory: \"output\" " << std::endl;
+		//get output dir
+		if (positionalArgs.size() == 1)
+		{
+			std::cout << "Default output directory: \"output\" " << std::endl;
+		}
+		else if (positionalArgs.size() == 2)
+		{
+			outpuDir = positionalArgs[1];
+		}
+
+		//create output dir
+		if (!std::filesystem::exists(outpuDir))
+		{
+			std::cout << "WARNING: Given output dir exists" << std::endl;
+			if (!std::filesystem::create_directories(outpuDir))
+			{
+				std::cout << "Can't create \"" << outpuDir << "\" dir" << std::endl;
+				return -2;
+			}
+		}
+		output.reset(new DirectorySink(outpuDir));
+		LogHelper::init(/*"logOutput.txt"*/);
 	}
-	else if (argc == 3)
+	else
 	{
-		outpuDir = std::string(argv[2]);
+		//logs are needed already to report problems with the archive
+		if (options.outputMode == OutputMode::Stdout)
+		{
+			LogHelper::initStdErr();
+		}
+		else
+		{
+			LogHelper::init(/*"logOutput.txt"*/);
+		}
+
+		std::unique_ptr<TarSink> tarOutput(new TarSink());
+		if (options.outputMode == OutputMode::Stdout)
+		{
+			if (!tarOutput->openStdout())
+			{
+				LogHelper::deinit();
+				return -3;
+			}
+		}
+		else
+		{
+			std::string tarPath = "output.tar";
+			if (positionalArgs.size() == 1)
+			{
+				std::cout << "Default output archive: \"output.tar\" " << std::endl;
+			}
+			else
+			{
+				tarPath = positionalArgs[1];
+			}
+
+			if (!tarOutput->open(tarPath))
+			{
+				LogHelper::deinit();
+				return -3;
+			}
+		}
+		output = std::move(tarOutput);
 	}
 
-	//create output dir
-	if (!std::filesystem::exists(outpuDir))
+	int status = analyzeMsi(msiFilePath, *output, options);
+
+	//archive is completed (end blocks) even if analysis failed, so partial results can be read
+	if (!output->finish())
 	{
-		std::cout << "WARNING: Given output dir exists" << std::endl;
-		if (!std::filesystem::create_directories(outpuDir))
+		LogHelper::PrintLog(LogLevel::Error, "Failed to finish the output");
+		if (status == 0)
 		{
-			std::cout << "Can't create \"" << outpuDir << "\" dir" << std::endl;
-			return -2;
+			status = -3;
 		}
 	}
-
-	LogHelper::init(/*"logOutput.txt"*/);
-	int status = analyzeMsi(msiFilePath, outpuDir);
 	LogHelper::deinit();
 
 	if (status == 0)
 	{
-		std::cout << "\n----------SUCCESS----------" << std::endl;
+		console << "\n----------SUCCESS----------" << std::endl;
 	}
 	else
 	{
-		std::cout << "\n----------FAILURE----------" << std::endl;
+		console << "\n----------FAILURE----------" << std::endl;
 	}
 	return status;
 }
 
-int analyzeMsi(std::string msiPath, std::string outpuDir)
+int analyzeMsi(std::string msiPath, OutputSink& output, const AnalyzeOptions& options)
 {
 	/*	How to analyze compoud file binary?
 		1. check a header and get important information
 		2. load fat entries (fat array contains metadata information about stream)
 			PS. If file is huge, then we need firstly load difat array, which contains
 			infomraiton about fat array
-		3. load mini fat entries (similarly like fat, but store metadata about ministream)
-		4. load dir section (it store infromation about type of data: storage, stream, ministream)
-		5. load ministream section (ministream store small streams, where size is less than section size)
+		3. load dir section (it store infromation about type of data: storage, stream, ministream)
+		4. validate sector chains (loops, sectors out of file, sectors shared by many streams)
+		PS. Mini fat entries and ministream (ministream store small streams, where size is less than section size)
+			are loaded by extractor on the first access to the small stream
 	*/
+	std::unique_ptr<ByteSource> input;
+	if (!openInput(msiPath, options, input))
+	{
+		LogHelper::PrintLog(LogLevel::Error, "Failed to open cfb file");
+		return -2;
+	}
+
 	CfbExtractor extractor;
-	ASSERT(extractor.initialize(msiPath));
+	ASSERT(extractor.initialize(std::move(input)));
 	LogHelper::PrintLog(LogLevel::Info, "Successful initialization of the extractor");
 
+	if (options.sectorCacheSizeSet)
+	{
+		extractor.setSectorCacheSize(options.sectorCacheSize);
+	}
+
 	ASSERT(extractor.parseCfbHeader());
 	LogHelper::PrintLog(LogLevel::Info, "Successful parsing of the cfbHeader");
 
 	ASSERT(extractor.loadFatEntries());
 	LogHelper::PrintLog(LogLevel::Info, "Successful loading of the fatEntries");
 
-	ASSERT(extractor.loadMiniFatEntries());
-	LogHelper::PrintLog(LogLevel::Info, "Successful loading of the miniFatEntries");
-
 	ASSERT(extractor.loadDirEntries());
 	LogHelper::PrintLog(LogLevel::Info, "Successful loading of the dirEntries");
 
-	ASSERT(extractor.loadMiniStreamEntries());
-	LogHelper::PrintLog(LogLevel::Info, "Successful loading of the miniStreamEntries");
+	//broken chains are only reported. Streams which use them will fail during reading
+	if (extractor.validateChains())
+	{
+		LogHelper::PrintLog(LogLevel::Info, "Successful validation of the sector chains");
+	}
+	else
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "Some sector chains are broken. Results can be incomplete");
+	}
 
 	//get a stream names
 	ASSERT(extractor.initRedableStreamNamesFromRawNames());
@@ -118,49 +362,80 @@ int analyzeMsi(std::string msiPath, std::string outpuDir)
 		It depends on our purpose. If we want check, what msi file can do during installation,
 		then we should analyze !_CustomAction.
 	*/
-	MsiTableParser parser(extractor, outpuDir);
+	//calling thread takes part in the parallel work, so pool has one thread less than jobs
+	std::unique_ptr<ThreadPool> threadPool;
+	if (options.jobs != 1)
+	{
+		threadPool.reset(new ThreadPool(options.jobs == 0 ? 0 : options.jobs - 1));
+	}
+	MsiTableParser parser(extractor, output);
+	parser.setIoBufferSize(options.ioBufferSize);
+	parser.setInFlightLimit(options.inFlightLimit);
+	parser.setThreadPool(threadPool.get());
+	parser.setTableCacheSize(options.tableCacheSize);
+	parser.setTableFormat(options.tableFormat);
+
+	/*	Stages below are run as a dependency graph, so independent stages overlap on the thread pool.
+		Metadata is a chain, but embedded files need only the extractor, so they are saved from the beginning.
+		Each stage is reported separately. If a stage fails, only stages which depend on it are skipped.
+	*/
+	DWORD savedScriptsCount = 0;
+	DWORD savedActionsCount = 0;
+	bool AI_FileDownload_IsPresent = false;
+	bool MPB_RunActions_IsPresent = false;
+	DWORD tablesNumber = 0;
+	DWORD savedFilesCount = 0;
+
+	StageGraph stages;
 	//	!_StringPool and !_StringData
-	ASSERT(parser.initStringVector());
-	LogHelper::PrintLog(LogLevel::Info, "Successful initialization of the msi strings");
+	const StageGraph::StageId stringsStage = stages.addStage("initialization of the msi strings",
+		[&parser]() { return parser.initStringVector(); });
 
 	//	!_Tables
-	ASSERT(parser.readTableNamesFromMetadata());
-	LogHelper::PrintLog(LogLevel::Info, "Successful printing of !_Tables");
+	const StageGraph::StageId tableNamesStage = stages.addStage("printing of !_Tables",
+		[&parser]() { return parser.readTableNamesFromMetadata(); }, { stringsStage });
 
 	//	!_Columns
-	ASSERT(parser.extractColumnsFromMetadata());
-	LogHelper::PrintLog(LogLevel::Info, "Successful extraction of !_Columns");
+	const StageGraph::StageId columnsStage = stages.addStage("extraction of !_Columns",
+		[&parser]() { return parser.extractColumnsFromMetadata(); }, { tableNamesStage });
 
 	//	!Property
-	ASSERT(parser.loadProperties());
-	LogHelper::PrintLog(LogLevel::Info, "Successful loading of !Properties");
+	const StageGraph::StageId propertiesStage = stages.addStage("loading of !Properties",
+		[&parser]() { return parser.loadProperties(); }, { columnsStage });
 
 	//	!CustomAction
-	DWORD savedScriptsCount = 0;
-	DWORD savedActionsCount = 0;
-	ASSERT(parser.analyzeCustomActionTable(savedScriptsCount, savedActionsCount));
-	LogHelper::PrintLog(LogLevel::Info, "Successful analysis of !CustomTable");
+	stages.addStage("analysis of !CustomTable",
+		[&parser, &savedScriptsCount, &savedActionsCount]() { return parser.analyzeCustomActionTable(savedScriptsCount, savedActionsCount); },
+		{ propertiesStage });
 
 	//	All Tables
-	bool AI_FileDownload_IsPresent = false;
-	bool MPB_RunActions_IsPresent = false;
-	DWORD tablesNumber = 0;
-	ASSERT(parser.saveAllTables(AI_FileDownload_IsPresent, MPB_RunActions_IsPresent, tablesNumber));
-	LogHelper::PrintLog(LogLevel::Info, "Successful saving all tables");
+	stages.addStage("saving all tables",
+		[&parser, &AI_FileDownload_IsPresent, &MPB_RunActions_IsPresent, &tablesNumber]()
+		{
+			return parser.saveAllTables(AI_FileDownload_IsPresent, MPB_RunActions_IsPresent, tablesNumber);
+		},
+		{ columnsStage });
 
 	//	All Files
-	DWORD savedFilesCount = 0;
-	ASSERT(parser.saveAllFiles(savedFilesCount));
-	LogHelper::PrintLog(LogLevel::Info, "Successful saving all embedded files");
+	stages.addStage("saving all embedded files",
+		[&parser, &savedFilesCount]() { return parser.saveAllFiles(savedFilesCount); });
 
-	//PRODUCE REPORT
-	std::ofstream reportStream(outpuDir + "\\analyzeReport.txt");
-	if (!reportStream)
-	{
-		LogHelper::PrintLog(LogLevel::Warning, "Can't open \"analyzeReport.txt\" file");
-		return -3;
-	}
+	ASSERT(stages.run(threadPool.get()));
+
+	//read amplification. Ideally each sector is read about once
+	const SectorCacheStats cacheStats = extractor.getSectorCacheStats();
+	std::string statsMsg = "Sector cache: hits " + std::to_string(cacheStats.hits) + ", misses " + std::to_string(cacheStats.misses)
+		+ ", read " + std::to_string(cacheStats.bytesRead) + " bytes (requested " + std::to_string(cacheStats.bytesRequested)
+		+ ") of file size " + std::to_string(extractor.getFileSize());
+	LogHelper::PrintLog(LogLevel::Info, statsMsg.data());
 
+	const TableCacheStats tableCacheStats = parser.getTableCacheStats();
+	statsMsg = "Table cache: hits " + std::to_string(tableCacheStats.hits) + ", decoded " + std::to_string(tableCacheStats.misses)
+		+ ", evicted " + std::to_string(tableCacheStats.evicted) + ", " + std::to_string(tableCacheStats.memoryUsage) + " bytes in use";
+	LogHelper::PrintLog(LogLevel::Info, statsMsg.data());
+
+	//PRODUCE REPORT
+	std::ostringstream reportStream;
 	reportStream << "----------REPORT----------" << std::endl;
 	reportStream << "Msi path: " << msiPath << std::endl;
 	reportStream << "Tables number:  \t" << tablesNumber << "\tSee \"<output_dir>\\tables\" directory" << std::endl;
@@ -183,7 +458,11 @@ int analyzeMsi(std::string msiPath, std::string outpuDir)
 	if (MPB_RunActions_IsPresent)
 		reportStream << "EMCO feature that supports additional actions. See: \"<output_dir>\\tables\\MPB_RunActions\" table" << std::endl;
 
-
-	reportStream.close();
+	const std::string report = reportStream.str();
+	if (!output.writeFile("analyzeReport.txt", report.data(), report.size()))
+	{
+		LogHelper::PrintLog(LogLevel::Warning, "Can't write \"analyzeReport.txt\" file");
+		return -3;
+	}
 	return 0;
 }
\ No newline at end of file